@@ -304,18 +304,9 @@ void OmpCsrSpmmT(
 {
     int num_cols = a.num_cols;
     int num_rows = a.num_rows;
-    int xt_index = 0;
 
     if (!g_input_row_major)
-    {
-        #pragma omp parallel for schedule(static) num_threads(num_threads) private(xt_index)
-        for (int i=0; i<num_cols; i++){
-            for(int j=i; j<num_cols*num_vectors; j+=num_cols){
-                vector_x_row_major[xt_index] = vector_x[j];
-                xt_index += 1;
-            }
-        }
-    }
+        ParallelTranspose(vector_x_row_major, vector_x, num_vectors, num_cols, num_threads);
 
     #pragma omp parallel for schedule(static) num_threads(num_threads)
     for (OffsetT row = 0; row < a.num_rows; ++row)
@@ -349,52 +340,6 @@ void OmpCsrSpmmT(
     }
 }
 
-template <
-    typename ValueT,
-    typename OffsetT>
-void OmpCsrSymSpmm(
-    int                             num_threads,
-    CsrMatrix<ValueT, OffsetT>&     a,
-    ValueT*      __restrict         vector_x,
-    ValueT*      __restrict         vector_y_out,
-    int                             num_vectors,
-    ValueT*      __restrict         vector_x_row_major)
-{
-    int num_cols = a.num_cols;
-    int num_rows = a.num_rows;
-    int xt_index = 0;
-
-    if (!g_input_row_major)
-    {
-        #pragma omp parallel for schedule(static) num_threads(num_threads) private(xt_index)
-        for (int i=0; i<num_cols; i++){
-            for(int j=i; j<num_cols*num_vectors; j+=num_cols){
-                vector_x_row_major[xt_index] = vector_x[j];
-                xt_index += 1;
-            }
-        }
-    }
-    #pragma omp parallel for schedule(static) num_threads(num_threads)
-    for (OffsetT row = 0; row < a.num_rows; ++row)
-    {
-        int ind = row*num_vectors;
-        for (
-            OffsetT offset = a.row_offsets[row];
-            offset < a.row_offsets[row + 1];
-            ++offset)
-        {
-            ValueT val = a.values[offset];
-            int ind_y = a.column_indices[offset]*num_vectors;
-            for (int i=0; i<num_vectors; i++){
-                vector_y_out[ind_y + i] += val * vector_x_row_major[ind + i];
-                if (row == 366 && i ==0){
-                    printf("%lf\n", val * vector_x_row_major[ind + i]);
-                }
-            }
-        }
-    }
-}
-
 /**
  * Run OmpCsrSpmm
  */
@@ -459,129 +404,114 @@ float TestOmpCsrSpmmT(
     return elapsed_ms / timing_iterations;
 }
 
+//---------------------------------------------------------------------
+// MKL SpMV
+//---------------------------------------------------------------------
+/**
+ * Create an MKL CSR handle for A (specialized for fp32)
+ */
+template <typename OffsetT>
+sparse_status_t MKLCreateCsr(
+    sparse_matrix_t                 &csrA,
+    CsrMatrix<float, OffsetT>&      a)
+{
+    return mkl_sparse_s_create_csr(&csrA, SPARSE_INDEX_BASE_ZERO, a.num_rows, a.num_cols, a.row_offsets, a.row_offsets + 1, a.column_indices, a.values);
+}
+
+/**
+ * Create an MKL CSR handle for A (specialized for fp64)
+ */
+template <typename OffsetT>
+sparse_status_t MKLCreateCsr(
+    sparse_matrix_t                 &csrA,
+    CsrMatrix<double, OffsetT>&     a)
+{
+    return mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ZERO, a.num_rows, a.num_cols, a.row_offsets, a.row_offsets + 1, a.column_indices, a.values);
+}
+
+/**
+ * Inspector stage: create the handle for A once, hint the expected number of
+ * SpMM calls with num_vectors columns in the current X layout, and let MKL
+ * optimize for it.  Returns the elapsed milliseconds.
+ */
 template <
     typename ValueT,
     typename OffsetT>
-float TestOmpCsrSymSpmm(
+float MKLCsrmmInspect(
+    sparse_matrix_t                 &csrA,
     CsrMatrix<ValueT, OffsetT>&     a,
-    ValueT*                         vector_x,
-    ValueT*                         reference_vector_y_out,
-    ValueT*                         vector_y_out,
-    int                             timing_iterations,
-    float                           &setup_ms,
-    int                             num_vectors,
-    ValueT*                         vector_x_row_major)
+    int                             num_vectors)
 {
-    setup_ms = 0.0;
-
-    if (g_omp_threads == -1)
-        g_omp_threads = omp_get_num_procs();
-    int num_threads = g_omp_threads;
-
-    if (!g_quiet)
-        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+    struct matrix_descr A_descr;
+    A_descr.type = SPARSE_MATRIX_TYPE_GENERAL;
+    sparse_layout_t layout = g_input_row_major ? SPARSE_LAYOUT_ROW_MAJOR : SPARSE_LAYOUT_COLUMN_MAJOR;
 
-    // Warmup/correctness
-    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
-    OmpCsrSymSpmm(g_omp_threads, a, vector_x, vector_y_out, num_vectors, vector_x_row_major);
-    if (!g_quiet)
-    {
-        // Check answer
-        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
-        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
-        if (g_input_row_major || g_output_row_major){
-            for(int i=0; i<a.num_rows; i++){
-                ValueT diff = reference_vector_y_out[i] - vector_y_out[i*num_vectors];
-                if(diff>0.000001 || diff<-0.0000001){
-                    printf("%lf, %lf, %d\n",reference_vector_y_out[i],vector_y_out[i*num_vectors],i);
-                }
-            }
-        }
-    }
- 
-    // Re-populate caches, etc.
-    for(int it = 0; it < timing_iterations; ++it)
-    {
-        OmpCsrSymSpmm(g_omp_threads, a, vector_x, vector_y_out, num_vectors, vector_x_row_major);
-    }
-    
-    // Timing
-    float elapsed_ms = 0.0;
     CpuTimer timer;
     timer.Start();
-    for(int it = 0; it < timing_iterations; ++it)
+
+    if (MKLCreateCsr(csrA, a) != SPARSE_STATUS_SUCCESS)
     {
-        OmpCsrSymSpmm(g_omp_threads, a, vector_x, vector_y_out, num_vectors, vector_x_row_major);
+        fprintf(stderr, "mkl_sparse_create_csr failed\n");
+        exit(1);
     }
+
+    // The hint and optimize steps are advisory: without them MKL still runs, just unoptimized
+    sparse_status_t hint_status     = mkl_sparse_set_mm_hint(csrA, SPARSE_OPERATION_NON_TRANSPOSE, A_descr, layout, num_vectors, g_expected_calls);
+    sparse_status_t optimize_status = mkl_sparse_optimize(csrA);
+
     timer.Stop();
-    elapsed_ms += timer.ElapsedMillis();
 
-    return elapsed_ms / timing_iterations;
+    if (!g_quiet && ((hint_status != SPARSE_STATUS_SUCCESS) || (optimize_status != SPARSE_STATUS_SUCCESS)))
+        printf("\tmkl_sparse_set_mm_hint/optimize not applied (status %d/%d)\n", (int) hint_status, (int) optimize_status);
+
+    return timer.ElapsedMillis();
 }
 
-//---------------------------------------------------------------------
-// MKL SpMV
-//---------------------------------------------------------------------
 /**
- * MKL CPU SpMV (specialized for fp32)
+ * MKL CPU SpMM executor (specialized for fp32)
  */
 template <typename OffsetT>
 void MKLCsrmm(
     int                           num_threads,
     CsrMatrix<float, OffsetT>&    a,
-    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
-    OffsetT*    __restrict        column_indices,
-    float*      __restrict        values,
+    sparse_matrix_t               csrA,
     float*      __restrict        vector_x,
     float*      __restrict        vector_y_out,
     int                           num_vectors)
 {
     struct matrix_descr A_descr; 
     A_descr.type = SPARSE_MATRIX_TYPE_GENERAL;
-    sparse_matrix_t csrA;
 
-    mkl_sparse_s_create_csr( &csrA, SPARSE_INDEX_BASE_ZERO, a.num_rows, a.num_cols, a.row_offsets, row_end_offsets, a.column_indices, a.values);
-    if (g_input_row_major && g_output_row_major)
-    {
-        mkl_sparse_s_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_ROW_MAJOR, vector_x, num_vectors, num_vectors, 0.0, vector_y_out, num_vectors); 
-    }
+    if (g_input_row_major)
+        mkl_sparse_s_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_ROW_MAJOR, vector_x, num_vectors, num_vectors, 0.0, vector_y_out, num_vectors);
     else
-    {
         mkl_sparse_s_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_COLUMN_MAJOR, vector_x, num_vectors, a.num_cols, 0.0, vector_y_out, a.num_rows);
-    }
 }
 
 /**
- * MKL CPU SpMV (specialized for fp64)
+ * MKL CPU SpMM executor (specialized for fp64)
  */
 template <typename OffsetT>
 void MKLCsrmm(
     int                            num_threads,
     CsrMatrix<double, OffsetT>&     a,
-    OffsetT*    __restrict         row_end_offsets,    ///< Merge list A (row end-offsets)
-    OffsetT*    __restrict         column_indices,
-    double*      __restrict        values,
+    sparse_matrix_t                csrA,
     double*      __restrict        vector_x,
     double*      __restrict        vector_y_out,
     int                           num_vectors)
 {
     struct matrix_descr A_descr; 
     A_descr.type = SPARSE_MATRIX_TYPE_GENERAL;
-    sparse_matrix_t csrA;
 
-    mkl_sparse_d_create_csr( &csrA, SPARSE_INDEX_BASE_ZERO, a.num_rows, a.num_cols, a.row_offsets, row_end_offsets, a.column_indices, a.values);
-    if (g_input_row_major && g_output_row_major)
-    {
-        mkl_sparse_d_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_ROW_MAJOR, vector_x, num_vectors, num_vectors, 0.0, vector_y_out, num_vectors); 
-    }
+    if (g_input_row_major)
+        mkl_sparse_d_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_ROW_MAJOR, vector_x, num_vectors, num_vectors, 0.0, vector_y_out, num_vectors);
     else
-    {
         mkl_sparse_d_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_COLUMN_MAJOR, vector_x, num_vectors, a.num_cols, 0.0, vector_y_out, a.num_rows);
-    }
 }
 
 /**
- * Run MKL CsrMV
+ * Run MKL CsrMM.  The handle is built and optimized once (reported as setup
+ * time); only the execute calls are timed.
  */
 template <
     typename ValueT,
@@ -595,11 +525,12 @@ float TestMKLCsrmm(
     float                           &setup_ms,
     int                             num_vectors)
 {
-    setup_ms = 0.0;
+    sparse_matrix_t csrA;
+    setup_ms = MKLCsrmmInspect(csrA, a, num_vectors);
 
     // Warmup/correctness
     memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
-    MKLCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors);
+    MKLCsrmm(g_omp_threads, a, csrA, vector_x, vector_y_out, num_vectors);
     if (!g_quiet)
     {
         // Check answer
@@ -610,7 +541,7 @@ float TestMKLCsrmm(
     // Re-populate caches, etc.
     for(int it = 0; it < timing_iterations; ++it)
     {
-        MKLCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors);
+        MKLCsrmm(g_omp_threads, a, csrA, vector_x, vector_y_out, num_vectors);
     }
     
     // Timing
@@ -619,11 +550,13 @@ float TestMKLCsrmm(
     timer.Start();
     for(int it = 0; it < timing_iterations; ++it)
     {
-        MKLCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors);
+        MKLCsrmm(g_omp_threads, a, csrA, vector_x, vector_y_out, num_vectors);
     }
     timer.Stop();
     elapsed_ms += timer.ElapsedMillis();
 
+    mkl_sparse_destroy(csrA);
+
     return elapsed_ms / timing_iterations;
 }
 
@@ -655,18 +588,9 @@ void OmpMergeCsrmm(
 
     int num_cols = a.num_cols;
     int num_rows = a.num_rows;
-    int xt_index = 0;
 
     if (!g_input_row_major)
-    {
-        #pragma omp parallel for schedule(static) num_threads(num_threads)
-        for (int i=0; i<num_cols; i++){
-            for(int j=i; j<num_cols*num_vectors; j+=num_cols){
-                vector_x_row_major[xt_index] = vector_x[j];
-                xt_index += 1;
-            }
-        }
-    }
+        ParallelTranspose(vector_x_row_major, vector_x, num_vectors, num_cols, num_threads);
 
     #pragma omp parallel for schedule(static) num_threads(num_threads)
     for (int tid = 0; tid < num_threads; tid++)
@@ -879,18 +803,9 @@ void OmpNonzeroSplitCsrmm(
 
     int num_cols = a.num_cols;
     int num_rows = a.num_rows;
-    int xt_index = 0;
 
     if (!g_input_row_major)
-    {
-        #pragma omp parallel for schedule(static) num_threads(num_threads)
-        for (int i=0; i<num_cols; i++){
-            for(int j=i; j<num_cols*num_vectors; j+=num_cols){
-                vector_x_row_major[xt_index] = vector_x[j];
-                xt_index += 1;
-            }
-        }
-    }
+        ParallelTranspose(vector_x_row_major, vector_x, num_vectors, num_cols, num_threads);
 
     #pragma omp parallel for schedule(static) num_threads(num_threads)
     for (int tid = 0; tid < num_threads; tid++)
@@ -1235,12 +1150,6 @@ void RunTests(
     // avg_ms = TestOmpCsrSpmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms, num_vectors);
     // DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
     
-    // col access SpMMT
-    // if (!g_quiet) printf("\n\n");
-    // printf("Simple SymCsrMM, "); fflush(stdout);
-    // avg_ms = TestOmpCsrSymSpmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms, num_vectors, vector_x_row_major);
-    // DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
-
     // Simple SpMMT
     if (!g_quiet) printf("\n\n");
     printf("Simple CsrMMT, "); fflush(stdout);
@@ -58,10 +58,13 @@
 #include <iostream>
 #include <limits>
 #include <immintrin.h>
+#include <unistd.h>
 
 #include <mkl.h>
 
 #include "sparse_matrix.h"
+#include "reorder.h"
+#include "spmm_microkernels.h"
 #include "utils.h"
 
 
@@ -77,6 +80,7 @@ int                     g_omp_threads       = -1;           // Number of openMP
 int                     g_expected_calls    = 1000000;
 bool                    g_input_row_major   = true;
 bool                    g_output_row_major  = true;
+size_t                  g_l2_bytes          = 1 << 20;      // L2 size used to size K-panels of the dense operand
 
 
 
@@ -250,33 +254,337 @@ inline void MergePathSearch(
 
 
 //---------------------------------------------------------------------
-// SpMV verification
+// SpMM verification
 //---------------------------------------------------------------------
 
-// Compute reference SpMV y = Ax
+/**
+ * Test input X(col, k): varies with both the row and the column of X (and is
+ * exactly representable), so an output column computed from the wrong X
+ * column, or left stale, shows up
+ */
+template <typename ValueT>
+ValueT SpmmInputValue(int col, int k)
+{
+    unsigned int h = unsigned(col) * 2654435761u + unsigned(k) * 40503u;
+    return ValueT(int(h >> 24) - 128) / 64;
+}
+
+
+/**
+ * Compute reference SpMM Y = AX in the layouts selected by g_input_row_major
+ * and g_output_row_major, with A's values taken from values (A's own, or any
+ * other value array sharing its sparsity pattern).  Rows are split across
+ * threads but each output is summed serially in nonzero order, so the result
+ * does not depend on the thread count.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void SpmmGold(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         values,
+    ValueT*                         vector_x,
+    ValueT*                         vector_y_out,
+    int                             num_vectors)
+{
+    size_t x_row_stride = g_input_row_major ? num_vectors : 1;
+    size_t x_stride     = g_input_row_major ? 1 : a.num_cols;
+    size_t y_row_stride = g_output_row_major ? num_vectors : 1;
+    size_t y_stride     = g_output_row_major ? 1 : a.num_rows;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (OffsetT row = 0; row < a.num_rows; ++row)
+    {
+        for (int k = 0; k < num_vectors; ++k)
+        {
+            ValueT partial = 0.0;
+            for (OffsetT offset = a.row_offsets[row]; offset < a.row_offsets[row + 1]; ++offset)
+                partial += values[offset] * vector_x[a.column_indices[offset] * x_row_stride + k * x_stride];
+            vector_y_out[row * y_row_stride + k * y_stride] = partial;
+        }
+    }
+}
+
 template <
     typename ValueT,
     typename OffsetT>
-void SpmvGold(
+void SpmmGold(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         vector_y_out,
+    int                             num_vectors)
+{
+    SpmmGold(num_threads, a, a.values, vector_x, vector_y_out, num_vectors);
+}
+
+
+/**
+ * Magnitude bound on output (row, k) after a row epilogue, given the bound
+ * magnitude on the output before it.  Activations are assumed to be no
+ * steeper than the identity (identity, relu), so only the scale and bias
+ * matter.
+ */
+template <typename OffsetT>
+double EpilogueMagnitude(
+    const NoEpilogue&       /*epilogue*/,
+    OffsetT                 /*row*/,
+    int                     /*k*/,
+    double                  magnitude)
+{
+    return magnitude;
+}
+
+template <
+    typename ScaleT,
+    typename BiasT,
+    typename ActivationT,
+    typename OffsetT>
+double EpilogueMagnitude(
+    const SpmmEpilogue<ScaleT, BiasT, ActivationT>&     epilogue,
+    OffsetT                                             row,
+    int                                                 k,
+    double                                              magnitude)
+{
+    return fabs(double(epilogue.scale(row))) * magnitude + fabs(double(epilogue.bias(k)));
+}
+
+
+/**
+ * Compare all num_vectors columns of an SpMM result against SpmmGold (or any
+ * other reference for the same product, with the same row epilogue applied).
+ * Two summations of the same row in different orders can differ by up to
+ * about 2 * n * eps * sum(|a_ij * x_jk|) for a row of n nonzeros, so each
+ * output is allowed that much error (with a little headroom, and scaled
+ * through the epilogue).  Outputs that compare equal always match, so rows
+ * that reduce to an infinite identity (empty max/min rows) pass.  Returns
+ * the number of mismatches, printing the first few if verbose.
+ */
+template <
+    typename ValueT,
+    typename OffsetT,
+    typename EpilogueT>
+OffsetT CompareSpmmResults(
+    int                             num_threads,
     CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         values,
     ValueT*                         vector_x,
-    ValueT*                         vector_y_in,
+    ValueT*                         reference_vector_y_out,
     ValueT*                         vector_y_out,
-    ValueT                          alpha,
-    ValueT                          beta)
+    int                             num_vectors,
+    const EpilogueT&                epilogue,
+    bool                            verbose)
 {
+    const double    eps             = std::numeric_limits<ValueT>::epsilon();
+    const int       max_reported    = 8;
+
+    size_t x_row_stride = g_input_row_major ? num_vectors : 1;
+    size_t x_stride     = g_input_row_major ? 1 : a.num_cols;
+    size_t y_row_stride = g_output_row_major ? num_vectors : 1;
+    size_t y_stride     = g_output_row_major ? 1 : a.num_rows;
+
+    OffsetT errors = 0;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads) reduction(+:errors)
     for (OffsetT row = 0; row < a.num_rows; ++row)
     {
-        ValueT partial = beta * vector_y_in[row];
-        for (
-            OffsetT offset = a.row_offsets[row];
-            offset < a.row_offsets[row + 1];
-            ++offset)
+        OffsetT row_length = a.row_offsets[row + 1] - a.row_offsets[row];
+        for (int k = 0; k < num_vectors; ++k)
         {
-            partial += alpha * a.values[offset] * vector_x[a.column_indices[offset]];
+            double magnitude = 0.0;
+            for (OffsetT offset = a.row_offsets[row]; offset < a.row_offsets[row + 1]; ++offset)
+                magnitude += fabs(double(values[offset]) * double(vector_x[a.column_indices[offset] * x_row_stride + k * x_stride]));
+
+            ValueT  expected    = reference_vector_y_out[row * y_row_stride + k * y_stride];
+            ValueT  computed    = vector_y_out[row * y_row_stride + k * y_stride];
+            double  tolerance   = 4.0 * (row_length + 2) * eps * EpilogueMagnitude(epilogue, row, k, magnitude);
+
+            // Written this way round so that NaN fails
+            if (!((computed == expected) || (fabs(double(computed) - double(expected)) <= tolerance)))
+            {
+                if (verbose)
+                {
+                    #pragma omp critical
+                    if (errors < max_reported)
+                        printf("\tINCORRECT: row %lld, column %d: %.10g != %.10g (tolerance %.3g)\n",
+                            (long long) row, k, double(computed), double(expected), tolerance);
+                }
+                errors++;
+            }
         }
-        vector_y_out[row] = partial;
     }
+
+    if (verbose && errors)
+        printf("\t%lld of %lld outputs incorrect\n", (long long) errors, (long long) a.num_rows * num_vectors);
+
+    return errors;
+}
+
+template <
+    typename ValueT,
+    typename OffsetT>
+OffsetT CompareSpmmResults(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         values,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             num_vectors,
+    bool                            verbose = true)
+{
+    return CompareSpmmResults(num_threads, a, values, vector_x, reference_vector_y_out, vector_y_out, num_vectors, NoEpilogue(), verbose);
+}
+
+template <
+    typename ValueT,
+    typename OffsetT>
+OffsetT CompareSpmmResults(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             num_vectors,
+    bool                            verbose = true)
+{
+    return CompareSpmmResults(num_threads, a, a.values, vector_x, reference_vector_y_out, vector_y_out, num_vectors, NoEpilogue(), verbose);
+}
+
+
+//---------------------------------------------------------------------
+// Layout conversion
+//---------------------------------------------------------------------
+
+/**
+ * Row-major copy of a column-major X (num_cols x num_vectors), for the
+ * kernels that gather whole rows of X.  Done once per test and reported as
+ * setup time; returns the elapsed milliseconds.
+ */
+template <typename ValueT>
+float ConvertInputToRowMajor(
+    int         num_threads,
+    ValueT*     vector_x_row_major,
+    ValueT*     vector_x,
+    int         num_cols,
+    int         num_vectors)
+{
+    CpuTimer timer;
+    timer.Start();
+
+    ParallelTranspose(vector_x_row_major, vector_x, num_vectors, num_cols, num_threads);
+
+    timer.Stop();
+    return timer.ElapsedMillis();
+}
+
+
+/**
+ * The copy loop from axpy.cpp, split across num_threads threads
+ */
+template <typename ValueT>
+void ParallelCopy(
+    ValueT*         dst,
+    const ValueT*   src,
+    size_t          num_items,
+    int             num_threads)
+{
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; ++tid)
+    {
+        size_t          begin   = num_items * tid / num_threads;
+        size_t          size    = num_items * (tid + 1) / num_threads - begin;
+        const ValueT*   x       = src + begin;
+        ValueT*         y       = dst + begin;
+        while (size--) { *(y++) = *(x++); }
+    }
+}
+
+
+/**
+ * Display a layout conversion timing (one row per test under --quiet)
+ */
+void DisplayTransposePerf(
+    double                          avg_ms,
+    double                          gbytes)
+{
+    if (!g_quiet)
+        printf("%.4f avg ms, %.3f GB/s\n", avg_ms, gbytes / (avg_ms / 1000.0));
+    else
+        printf("%.5f, %.3f, ", avg_ms, gbytes / (avg_ms / 1000.0));
+
+    fflush(stdout);
+}
+
+
+/**
+ * Layout conversion benchmark (--transpose_bench).  Times the serial and the
+ * parallel transpose of X against the copy loop from axpy.cpp split across
+ * threads, reporting bytes read plus written per second.
+ */
+template <typename ValueT>
+void TestTranspose(
+    ValueT*     vector_x_row_major,
+    ValueT*     vector_x,
+    int         num_cols,
+    int         num_vectors,
+    int         timing_iterations)
+{
+    size_t  num_items   = size_t(num_cols) * num_vectors;
+    double  gbytes      = 2.0 * sizeof(ValueT) * num_items / 1.0e9;
+    ValueT* reference   = new ValueT[num_items];
+    CpuTimer timer;
+
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    // Copy baseline
+    printf("Copy, "); fflush(stdout);
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+    ParallelCopy(vector_x_row_major, vector_x, num_items, g_omp_threads);
+    timer.Start();
+    for (int it = 0; it < timing_iterations; ++it)
+        ParallelCopy(vector_x_row_major, vector_x, num_items, g_omp_threads);
+    timer.Stop();
+    DisplayTransposePerf(timer.ElapsedMillis() / timing_iterations, gbytes);
+
+    // Serial transpose
+    if (!g_quiet) printf("\n\n");
+    printf("Serial transpose, "); fflush(stdout);
+    transpose(reference, vector_x, num_vectors, num_cols);
+    timer.Start();
+    for (int it = 0; it < timing_iterations; ++it)
+        transpose(reference, vector_x, num_vectors, num_cols);
+    timer.Stop();
+    DisplayTransposePerf(timer.ElapsedMillis() / timing_iterations, gbytes);
+
+    // Parallel transpose
+    if (!g_quiet) printf("\n\n");
+    printf("Parallel transpose, "); fflush(stdout);
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+    ParallelTranspose(vector_x_row_major, vector_x, num_vectors, num_cols, g_omp_threads);
+    if (!g_quiet)
+    {
+        // A transpose is an exact permutation: any difference is an error
+        size_t mismatch = 0;
+        while ((mismatch < num_items) && (memcmp(&reference[mismatch], &vector_x_row_major[mismatch], sizeof(ValueT)) == 0))
+            ++mismatch;
+        if (mismatch < num_items)
+            printf("\tINCORRECT: row %lld, column %lld: %.10g != %.10g\n",
+                (long long) (mismatch / num_vectors), (long long) (mismatch % num_vectors),
+                double(vector_x_row_major[mismatch]), double(reference[mismatch]));
+        printf("\t%s\n", (mismatch < num_items) ? "FAIL" : "PASS"); fflush(stdout);
+    }
+    timer.Start();
+    for (int it = 0; it < timing_iterations; ++it)
+        ParallelTranspose(vector_x_row_major, vector_x, num_vectors, num_cols, g_omp_threads);
+    timer.Stop();
+    DisplayTransposePerf(timer.ElapsedMillis() / timing_iterations, gbytes);
+
+    delete[] reference;
 }
 
 
@@ -290,55 +598,17 @@ template <
 void OmpCsrSpmmT(
     int                             num_threads,
     CsrMatrix<ValueT, OffsetT>&     a,
-    ValueT*      __restrict         vector_x,
     ValueT*      __restrict         vector_y_out,
     int                             num_vectors,
     ValueT*      __restrict         vector_x_row_major)
 {
-    int num_cols = a.num_cols;
-    int num_rows = a.num_rows;
-    int xt_index = 0;
-
-    if (!g_input_row_major)
-    {
-        #pragma omp parallel for schedule(static) num_threads(num_threads) private(xt_index)
-        for (int i=0; i<num_cols; i++){
-            for(int j=i; j<num_cols*num_vectors; j+=num_cols){
-                vector_x_row_major[xt_index] = vector_x[j];
-                xt_index += 1;
-            }
-        }
-    }
+    int y_stride        = g_output_row_major ? 1 : a.num_rows;
+    int y_row_stride    = g_output_row_major ? num_vectors : 1;
 
     #pragma omp parallel for schedule(static) num_threads(num_threads)
     for (OffsetT row = 0; row < a.num_rows; ++row)
     {
-        ValueT partial[num_vectors] = {0.0};
-        for (
-            OffsetT offset = a.row_offsets[row];
-            offset < a.row_offsets[row + 1];
-            ++offset)
-        {
-            ValueT val = a.values[offset];
-            int ind = a.column_indices[offset]*num_vectors;
-            for (int i=0; i<num_vectors; i++){
-                partial[i] += val * vector_x_row_major[ind + i];
-            }
-        }
-        
-        if (g_output_row_major)
-        {
-            int ind = row*num_vectors;
-            for (int i=0; i<num_vectors; i++){
-                vector_y_out[ind + i] = partial[i];
-            }
-        }
-        else
-        {
-            for (int i=0; i<num_vectors; i++){
-                vector_y_out[row + i * num_rows] = partial[i];
-            }
-        }
+        SpmmRow(a.column_indices, a.values, a.row_offsets[row], a.row_offsets[row + 1], vector_x_row_major, num_vectors, num_vectors, vector_y_out + row * y_row_stride, y_stride);
     }
 }
 
@@ -359,10 +629,11 @@ float TestOmpCsrSpmmT(
     int                             num_vectors,
     ValueT*                         vector_x_row_major)
 {
-    setup_ms = 0.0;
-
     if (g_omp_threads == -1)
         g_omp_threads = omp_get_num_procs();
+
+    // Column-major X is converted once, outside the timed loop
+    setup_ms = g_input_row_major ? 0.0 : ConvertInputToRowMajor(g_omp_threads, vector_x_row_major, vector_x, a.num_cols, num_vectors);
     int num_threads = g_omp_threads;
 
     if (!g_quiet)
@@ -370,26 +641,18 @@ float TestOmpCsrSpmmT(
 
     // Warmup/correctness
     memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
-    OmpCsrSpmmT(g_omp_threads, a, vector_x, vector_y_out, num_vectors, vector_x_row_major);
+    OmpCsrSpmmT(g_omp_threads, a, vector_y_out, num_vectors, vector_x_row_major);
     if (!g_quiet)
     {
         // Check answer
-        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
         printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
-        if (g_input_row_major || g_output_row_major){
-            for(int i=0; i<a.num_rows; i++){
-                ValueT diff = reference_vector_y_out[i] - vector_y_out[i*num_vectors];
-                if(diff>0.000001 || diff<-0.0000001){
-                    printf("%lf, %lf\n",reference_vector_y_out[i],vector_y_out[i*num_vectors]);
-                }
-            }
-        }
     }
  
     // Re-populate caches, etc.
     for(int it = 0; it < timing_iterations; ++it)
     {
-        OmpCsrSpmmT(g_omp_threads, a, vector_x, vector_y_out, num_vectors, vector_x_row_major);
+        OmpCsrSpmmT(g_omp_threads, a, vector_y_out, num_vectors, vector_x_row_major);
     }
     
     // Timing
@@ -398,7 +661,7 @@ float TestOmpCsrSpmmT(
     timer.Start();
     for(int it = 0; it < timing_iterations; ++it)
     {
-        OmpCsrSpmmT(g_omp_threads, a, vector_x, vector_y_out, num_vectors, vector_x_row_major);
+        OmpCsrSpmmT(g_omp_threads, a, vector_y_out, num_vectors, vector_x_row_major);
     }
     timer.Stop();
     elapsed_ms += timer.ElapsedMillis();
@@ -410,51 +673,110 @@ float TestOmpCsrSpmmT(
 // MKL SpMV
 //---------------------------------------------------------------------
 /**
- * MKL CPU SpMV (specialized for fp32)
+ * Create an MKL CSR handle for A (specialized for fp32)
+ */
+template <typename OffsetT>
+sparse_status_t MKLCreateCsr(
+    sparse_matrix_t                 &csrA,
+    CsrMatrix<float, OffsetT>&      a)
+{
+    return mkl_sparse_s_create_csr(&csrA, SPARSE_INDEX_BASE_ZERO, a.num_rows, a.num_cols, a.row_offsets, a.row_offsets + 1, a.column_indices, a.values);
+}
+
+/**
+ * Create an MKL CSR handle for A (specialized for fp64)
+ */
+template <typename OffsetT>
+sparse_status_t MKLCreateCsr(
+    sparse_matrix_t                 &csrA,
+    CsrMatrix<double, OffsetT>&     a)
+{
+    return mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ZERO, a.num_rows, a.num_cols, a.row_offsets, a.row_offsets + 1, a.column_indices, a.values);
+}
+
+/**
+ * Inspector stage: create the handle for A once, hint the expected number of
+ * SpMM calls with num_vectors columns in the current X layout, and let MKL
+ * optimize for it.  Returns the elapsed milliseconds.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float MKLCsrmmInspect(
+    sparse_matrix_t                 &csrA,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    int                             num_vectors)
+{
+    struct matrix_descr A_descr;
+    A_descr.type = SPARSE_MATRIX_TYPE_GENERAL;
+    sparse_layout_t layout = g_input_row_major ? SPARSE_LAYOUT_ROW_MAJOR : SPARSE_LAYOUT_COLUMN_MAJOR;
+
+    CpuTimer timer;
+    timer.Start();
+
+    if (MKLCreateCsr(csrA, a) != SPARSE_STATUS_SUCCESS)
+    {
+        fprintf(stderr, "mkl_sparse_create_csr failed\n");
+        exit(1);
+    }
+
+    // The hint and optimize steps are advisory: without them MKL still runs, just unoptimized
+    sparse_status_t hint_status     = mkl_sparse_set_mm_hint(csrA, SPARSE_OPERATION_NON_TRANSPOSE, A_descr, layout, num_vectors, g_expected_calls);
+    sparse_status_t optimize_status = mkl_sparse_optimize(csrA);
+
+    timer.Stop();
+
+    if (!g_quiet && ((hint_status != SPARSE_STATUS_SUCCESS) || (optimize_status != SPARSE_STATUS_SUCCESS)))
+        printf("\tmkl_sparse_set_mm_hint/optimize not applied (status %d/%d)\n", (int) hint_status, (int) optimize_status);
+
+    return timer.ElapsedMillis();
+}
+
+/**
+ * MKL CPU SpMM executor (specialized for fp32)
  */
 template <typename OffsetT>
 void MKLCsrmm(
     int                           num_threads,
     CsrMatrix<float, OffsetT>&    a,
-    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
-    OffsetT*    __restrict        column_indices,
-    float*      __restrict        values,
+    sparse_matrix_t               csrA,
     float*      __restrict        vector_x,
     float*      __restrict        vector_y_out,
     int                           num_vectors)
 {
     struct matrix_descr A_descr; 
     A_descr.type = SPARSE_MATRIX_TYPE_GENERAL;
-    sparse_matrix_t csrA;
 
-    mkl_sparse_s_create_csr( &csrA, SPARSE_INDEX_BASE_ZERO, a.num_rows, a.num_cols, a.row_offsets, row_end_offsets, a.column_indices, a.values);
-    mkl_sparse_s_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_ROW_MAJOR, vector_x, num_vectors, num_vectors, 0.0, vector_y_out, num_vectors); 
+    if (g_input_row_major)
+        mkl_sparse_s_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_ROW_MAJOR, vector_x, num_vectors, num_vectors, 0.0, vector_y_out, num_vectors);
+    else
+        mkl_sparse_s_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_COLUMN_MAJOR, vector_x, num_vectors, a.num_cols, 0.0, vector_y_out, a.num_rows);
 }
 
 /**
- * MKL CPU SpMV (specialized for fp64)
+ * MKL CPU SpMM executor (specialized for fp64)
  */
 template <typename OffsetT>
 void MKLCsrmm(
     int                            num_threads,
     CsrMatrix<double, OffsetT>&     a,
-    OffsetT*    __restrict         row_end_offsets,    ///< Merge list A (row end-offsets)
-    OffsetT*    __restrict         column_indices,
-    double*      __restrict        values,
+    sparse_matrix_t                csrA,
     double*      __restrict        vector_x,
     double*      __restrict        vector_y_out,
     int                           num_vectors)
 {
     struct matrix_descr A_descr; 
     A_descr.type = SPARSE_MATRIX_TYPE_GENERAL;
-    sparse_matrix_t csrA;
 
-    mkl_sparse_d_create_csr( &csrA, SPARSE_INDEX_BASE_ZERO, a.num_rows, a.num_cols, a.row_offsets, row_end_offsets, a.column_indices, a.values);
-    mkl_sparse_d_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_ROW_MAJOR, vector_x, num_vectors, num_vectors, 0.0, vector_y_out, num_vectors); 
+    if (g_input_row_major)
+        mkl_sparse_d_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_ROW_MAJOR, vector_x, num_vectors, num_vectors, 0.0, vector_y_out, num_vectors);
+    else
+        mkl_sparse_d_mm(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, A_descr, SPARSE_LAYOUT_COLUMN_MAJOR, vector_x, num_vectors, a.num_cols, 0.0, vector_y_out, a.num_rows);
 }
 
 /**
- * Run MKL CsrMV
+ * Run MKL CsrMM.  The handle is built and optimized once (reported as setup
+ * time); only the execute calls are timed.
  */
 template <
     typename ValueT,
@@ -468,22 +790,23 @@ float TestMKLCsrmm(
     float                           &setup_ms,
     int                             num_vectors)
 {
-    setup_ms = 0.0;
+    sparse_matrix_t csrA;
+    setup_ms = MKLCsrmmInspect(csrA, a, num_vectors);
 
     // Warmup/correctness
     memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
-    MKLCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors);
+    MKLCsrmm(g_omp_threads, a, csrA, vector_x, vector_y_out, num_vectors);
     if (!g_quiet)
     {
         // Check answer
-        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
         printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
     }
 
     // Re-populate caches, etc.
     for(int it = 0; it < timing_iterations; ++it)
     {
-        MKLCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors);
+        MKLCsrmm(g_omp_threads, a, csrA, vector_x, vector_y_out, num_vectors);
     }
     
     // Timing
@@ -492,43 +815,103 @@ float TestMKLCsrmm(
     timer.Start();
     for(int it = 0; it < timing_iterations; ++it)
     {
-        MKLCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors);
+        MKLCsrmm(g_omp_threads, a, csrA, vector_x, vector_y_out, num_vectors);
     }
     timer.Stop();
     elapsed_ms += timer.ElapsedMillis();
 
+    mkl_sparse_destroy(csrA);
+
     return elapsed_ms / timing_iterations;
 }
 
+/**
+ * MKL dense GEMM C = op(A) op(B) (specialized for fp32)
+ */
+inline void DenseGemm(
+    CBLAS_LAYOUT        layout,
+    CBLAS_TRANSPOSE     trans_a,
+    CBLAS_TRANSPOSE     trans_b,
+    int                 m,
+    int                 n,
+    int                 k,
+    const float*        a,
+    int                 lda,
+    const float*        b,
+    int                 ldb,
+    float*              c,
+    int                 ldc)
+{
+    cblas_sgemm(layout, trans_a, trans_b, m, n, k, 1.0f, a, lda, b, ldb, 0.0f, c, ldc);
+}
+
+/**
+ * MKL dense GEMM C = op(A) op(B) (specialized for fp64)
+ */
+inline void DenseGemm(
+    CBLAS_LAYOUT        layout,
+    CBLAS_TRANSPOSE     trans_a,
+    CBLAS_TRANSPOSE     trans_b,
+    int                 m,
+    int                 n,
+    int                 k,
+    const double*       a,
+    int                 lda,
+    const double*       b,
+    int                 ldb,
+    double*             c,
+    int                 ldc)
+{
+    cblas_dgemm(layout, trans_a, trans_b, m, n, k, 1.0, a, lda, b, ldb, 0.0, c, ldc);
+}
+
 //---------------------------------------------------------------------
 // CPU merge-based SpMV
 //---------------------------------------------------------------------
 
 
 /**
- * OpenMP CPU merge-based SpMV
+ * OpenMP CPU merge-based SpMM over a semiring (PlusTimes for plain SpMM,
+ * MaxTimes/MinTimes for max/min aggregation).  Reads X and writes Y directly
+ * in the layouts selected by g_input_row_major and g_output_row_major, with
+ * leading dimensions ldx and ldy (the stride between rows of a row-major
+ * operand, or between columns of a column-major one), so X and Y may be
+ * views into wider matrices.  X may be stored in a narrower type than
+ * ValueT (fp32 X for fp64 A and Y); it is widened as it is loaded, so all
+ * accumulation is in ValueT.  Carry-outs are merged with the semiring's
+ * combine operator.  The epilogue is applied once to every output row: inline
+ * as a thread finishes a row, except for a thread's first row, which may
+ * still receive carry-outs from earlier threads and is finished after the
+ * fix-up.
  */
 template <
     typename ValueT,
-    typename OffsetT>
+    typename OffsetT,
+    typename InputT,
+    typename SemiringT,
+    typename EpilogueT>
 void OmpMergeCsrmm(
     int                             num_threads,
     CsrMatrix<ValueT, OffsetT>&     a,
     OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
     OffsetT*    __restrict        column_indices,
     ValueT*     __restrict        values,
-    ValueT*     __restrict        vector_x,
+    InputT*     __restrict        vector_x,
+    int                           ldx,                ///< Leading dimension of X
     ValueT*     __restrict        vector_y_out,
+    int                           ldy,                ///< Leading dimension of Y
     int                           num_vectors,
-    ValueT*     __restrict        vector_x_row_major)
+    SpmmScratch<ValueT, OffsetT>& scratch,            ///< Per-thread carry-outs for inter-thread fix-up after load-balanced work
+    const SemiringT&              semiring,           ///< Row reduction (combine, multiply)
+    const EpilogueT&              epilogue)           ///< Per-row output epilogue
 {
-    // Temporary storage for inter-thread fix-up after load-balanced work
-    OffsetT     row_carry_out[256];     // The last row-id each worked on by each thread when it finished its path segment
-    ValueT*     value_carry_out[256];   // The running total within each thread when it finished its path segment
+    typedef ScalarTraits<ValueT> Scalar;
+
+    scratch.Reserve(num_threads, num_vectors);
 
-    int num_cols = a.num_cols;
-    int num_rows = a.num_rows;
-    int xt_index = 0;
+    // X and Y are used in place in whichever layout they are in
+    int y_stride        = g_output_row_major ? 1 : ldy;
+    int y_row_stride    = g_output_row_major ? ldy : 1;
 
     #pragma omp parallel for schedule(static) num_threads(num_threads)
     for (int tid = 0; tid < num_threads; tid++)
@@ -548,78 +931,133 @@ void OmpMergeCsrmm(
         MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord);
         MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord_end);
 
-        // Consume whole rows
-        ValueT running_total[num_vectors] = {0.0};
-        ValueT val;
-        int ind;
-        ValueT* tmp;
+        // Consume whole rows (the first row of every thread but the first is finished after the fix-up)
+        OffsetT first_row = (tid > 0) ? thread_coord.x : -1;
         for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
         {
-            for (; thread_coord.y < row_end_offsets[thread_coord.x]; ++thread_coord.y)
-            {
-                val = values[thread_coord.y];
-                ind = column_indices[thread_coord.y]*num_vectors;
-                tmp = vector_x_row_major+ind;
-                for (int i=0; i<num_vectors; i++){
-                    running_total[i] += val * tmp[i];
-                }
-            }
-
-            ind = thread_coord.x*num_vectors;
-            tmp = vector_y_out+ind;
-            for (int i=0; i<num_vectors; i++){
-                tmp[i] = running_total[i];
-                running_total[i] = 0.0;
-            }
+            ValueT* y = vector_y_out + size_t(thread_coord.x) * y_row_stride;
+            SpmmRow(g_input_row_major, column_indices, values, thread_coord.y, row_end_offsets[thread_coord.x], vector_x, ldx, num_vectors, y, y_stride, semiring);
+            if (thread_coord.x != first_row)
+                epilogue(thread_coord.x, y, y_stride, num_vectors);
+            thread_coord.y = row_end_offsets[thread_coord.x];
         }
 
         // Consume partial portion of thread's last row
-        for (; thread_coord.y < thread_coord_end.y; ++thread_coord.y)
-        {
-            val = values[thread_coord.y];
-            ind = column_indices[thread_coord.y]*num_vectors;
-            tmp = vector_x_row_major+ind;
-            for (int i=0; i<num_vectors; i++){
-                running_total[i] += val * tmp[i];
-            }
-        }
+        SpmmRow(g_input_row_major, column_indices, values, thread_coord.y, thread_coord_end.y, vector_x, ldx, num_vectors, scratch.Carry(tid), 1, semiring);
 
         // Save carry-outs
-        row_carry_out[tid] = thread_coord_end.x;
-        value_carry_out[tid] = running_total;
+        scratch.CarryRow(tid) = thread_coord_end.x;
     }
 
     // Carry-out fix-up (rows spanning multiple threads)
-    int ind;
-    ValueT* tmp;
     for (int tid = 0; tid < num_threads - 1; ++tid)
     {
-        if (row_carry_out[tid] < a.num_rows){
-            ind = row_carry_out[tid]*num_vectors;
-            tmp = vector_y_out+ind;
-            for (int i=0; i<num_vectors; i++){
-                tmp[i] += value_carry_out[tid][i];
-            }
+        if (scratch.CarryRow(tid) < a.num_rows)
+        {
+            ValueT* y       = vector_y_out + size_t(scratch.CarryRow(tid)) * y_row_stride;
+            ValueT* carry   = scratch.Carry(tid);
+            for (int i = 0; i < num_vectors; ++i)
+                y[i * y_stride] = SemiringT::template Combine<Scalar>(y[i * y_stride], carry[i]);
         }
     }
+
+    // Deferred epilogues: a thread's first row, once the thread that finished it is known
+    for (int tid = 1; tid < num_threads; ++tid)
+    {
+        OffsetT row = scratch.CarryRow(tid - 1);
+        if ((row < a.num_rows) && (scratch.CarryRow(tid) != row))
+            epilogue(row, vector_y_out + size_t(row) * y_row_stride, y_stride, num_vectors);
+    }
 }
 
 
 /**
- * Run OmpMergeCsrmm
+ * OpenMP CPU merge-based SpMM over (+, *) without an epilogue, on strided X
+ * and Y
  */
 template <
     typename ValueT,
     typename OffsetT>
-float TestOmpMergeCsrmm(
+void OmpMergeCsrmm(
+    int                             num_threads,
     CsrMatrix<ValueT, OffsetT>&     a,
-    ValueT*                         vector_x,
-    ValueT*                         reference_vector_y_out,
-    ValueT*                         vector_y_out,
-    int                             timing_iterations,
-    float                           &setup_ms,
-    int                             num_vectors,
-    ValueT*                         vector_x_row_major)
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    ValueT*     __restrict        values,
+    ValueT*     __restrict        vector_x,
+    int                           ldx,                ///< Leading dimension of X
+    ValueT*     __restrict        vector_y_out,
+    int                           ldy,                ///< Leading dimension of Y
+    int                           num_vectors,
+    SpmmScratch<ValueT, OffsetT>& scratch)            ///< Per-thread carry-outs for inter-thread fix-up after load-balanced work
+{
+    OmpMergeCsrmm(num_threads, a, row_end_offsets, column_indices, values, vector_x, ldx, vector_y_out, ldy, num_vectors, scratch, PlusTimes<ValueT>(), NoEpilogue());
+}
+
+
+/**
+ * OpenMP CPU merge-based SpMM on packed X and Y
+ */
+template <
+    typename ValueT,
+    typename OffsetT,
+    typename SemiringT,
+    typename EpilogueT>
+void OmpMergeCsrmm(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    ValueT*     __restrict        values,
+    ValueT*     __restrict        vector_x,
+    ValueT*     __restrict        vector_y_out,
+    int                           num_vectors,
+    SpmmScratch<ValueT, OffsetT>& scratch,            ///< Per-thread carry-outs for inter-thread fix-up after load-balanced work
+    const SemiringT&              semiring,           ///< Row reduction (combine, multiply)
+    const EpilogueT&              epilogue)           ///< Per-row output epilogue
+{
+    int ldx = g_input_row_major ? num_vectors : a.num_cols;
+    int ldy = g_output_row_major ? num_vectors : a.num_rows;
+    OmpMergeCsrmm(num_threads, a, row_end_offsets, column_indices, values, vector_x, ldx, vector_y_out, ldy, num_vectors, scratch, semiring, epilogue);
+}
+
+
+/**
+ * OpenMP CPU merge-based SpMM over (+, *) without an epilogue, on packed X
+ * and Y
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMergeCsrmm(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    ValueT*     __restrict        values,
+    ValueT*     __restrict        vector_x,
+    ValueT*     __restrict        vector_y_out,
+    int                           num_vectors,
+    SpmmScratch<ValueT, OffsetT>& scratch)            ///< Per-thread carry-outs for inter-thread fix-up after load-balanced work
+{
+    OmpMergeCsrmm(num_threads, a, row_end_offsets, column_indices, values, vector_x, vector_y_out, num_vectors, scratch, PlusTimes<ValueT>(), NoEpilogue());
+}
+
+
+/**
+ * Run OmpMergeCsrmm
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpMergeCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms,
+    int                             num_vectors)
 {
     setup_ms = 0.0;
 
@@ -628,167 +1066,2849 @@ float TestOmpMergeCsrmm(
     int num_threads = g_omp_threads;
 
     if (!g_quiet)
-        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
+    OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+ 
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    return elapsed_ms / timing_iterations;
+}
+
+
+/**
+ * OpenMP CPU merge-based SpMM that writes finished rows of a row-major Y
+ * with non-temporal stores, saving the read-for-ownership of every output
+ * line written in full.  A thread's rows follow each other in memory, so
+ * each row is accumulated in the thread's carry buffer and appended to one
+ * write-combining line buffer.  A thread's first row, which may still
+ * receive carry-outs, is stored normally, as is a column-major Y: its rows
+ * each touch num_vectors different lines, and per-column line buffers cost
+ * more than the read-for-ownership they save.  Returns the number of cache
+ * lines streamed.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+size_t OmpMergeStreamingCsrmm(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    ValueT*     __restrict        values,
+    ValueT*     __restrict        vector_x,
+    ValueT*     __restrict        vector_y_out,
+    int                           num_vectors,
+    SpmmScratch<ValueT, OffsetT>& scratch)            ///< Per-thread carry-outs for inter-thread fix-up after load-balanced work
+{
+    scratch.Reserve(num_threads, num_vectors);
+
+    int     ldx             = g_input_row_major ? num_vectors : a.num_cols;
+    int     y_stride        = g_output_row_major ? 1 : a.num_rows;
+    int     y_row_stride    = g_output_row_major ? num_vectors : 1;
+    size_t  streamed_lines  = 0;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads) reduction(+:streamed_lines)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        // Merge list B (NZ indices)
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+
+        OffsetT num_merge_items     = a.num_rows + a.num_nonzeros;                          // Merge path total length
+        OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;    // Merge items per thread
+
+        // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
+        int2    thread_coord;
+        int2    thread_coord_end;
+        int     start_diagonal      = std::min(items_per_thread * tid, num_merge_items);
+        int     end_diagonal        = std::min(start_diagonal + items_per_thread, num_merge_items);
+
+        MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord);
+        MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord_end);
+
+        StreamingLineBuffer<ValueT> writer;
+        ValueT*                     row_out = scratch.Carry(tid);
+
+        // Consume whole rows (the first row of every thread but the first may receive carry-outs)
+        OffsetT first_row = (tid > 0) ? thread_coord.x : -1;
+        for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+        {
+            ValueT* y = vector_y_out + size_t(thread_coord.x) * y_row_stride;
+            if ((thread_coord.x == first_row) || !g_output_row_major)
+            {
+                SpmmRow(g_input_row_major, column_indices, values, thread_coord.y, row_end_offsets[thread_coord.x], vector_x, ldx, num_vectors, y, y_stride);
+            }
+            else
+            {
+                SpmmRow(g_input_row_major, column_indices, values, thread_coord.y, row_end_offsets[thread_coord.x], vector_x, ldx, num_vectors, row_out, 1);
+                writer.Put(y, row_out, num_vectors);
+            }
+            thread_coord.y = row_end_offsets[thread_coord.x];
+        }
+
+        writer.Flush();
+        streamed_lines += writer.streamed_lines;
+        _mm_sfence();
+
+        // Consume partial portion of thread's last row
+        SpmmRow(g_input_row_major, column_indices, values, thread_coord.y, thread_coord_end.y, vector_x, ldx, num_vectors, row_out, 1);
+
+        // Save carry-outs
+        scratch.CarryRow(tid) = thread_coord_end.x;
+    }
+
+    // Carry-out fix-up (rows spanning multiple threads)
+    for (int tid = 0; tid < num_threads - 1; ++tid)
+    {
+        if (scratch.CarryRow(tid) < a.num_rows)
+        {
+            ValueT* y       = vector_y_out + size_t(scratch.CarryRow(tid)) * y_row_stride;
+            ValueT* carry   = scratch.Carry(tid);
+            for (int i = 0; i < num_vectors; ++i)
+                y[i * y_stride] += carry[i];
+        }
+    }
+
+    return streamed_lines;
+}
+
+
+/**
+ * Run OmpMergeStreamingCsrmm against OmpMergeCsrmm (normal_ms).  Besides the
+ * usual model, reports the output read-for-ownership traffic each kernel
+ * actually causes: normal stores read every line of Y before writing it,
+ * streamed lines are not read.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpMergeStreamingCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &normal_ms,
+    int                             num_vectors)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
+    size_t streamed_lines = OmpMergeStreamingCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+
+    // Normal-store timing
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch);
+    }
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch);
+    }
+    timer.Stop();
+    normal_ms = timer.ElapsedMillis() / timing_iterations;
+
+    // Streaming timing
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeStreamingCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch);
+    }
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeStreamingCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch);
+    }
+    timer.Stop();
+    float streaming_ms = timer.ElapsedMillis() / timing_iterations;
+
+    if (!g_quiet)
+    {
+        // Y is read for ownership line by line under normal stores (DisplayPerf counts its writes only)
+        double y_bytes         = double(a.num_rows) * num_vectors * sizeof(ValueT);
+        double streamed_bytes  = double(streamed_lines) * StreamingLineBuffer<ValueT>::LINE_BYTES;
+        double model_bytes     = double(a.num_nonzeros) * (sizeof(ValueT) * 2 + sizeof(OffsetT)) +
+                                 double(a.num_rows) * num_vectors * (sizeof(OffsetT) + sizeof(ValueT));
+        printf("\t%.2f of %.2f MB of Y streamed (%.1f%%), saving %.2f MB of read-for-ownership per call\n",
+            streamed_bytes / 1.0e6, y_bytes / 1.0e6, 100.0 * streamed_bytes / std::max(y_bytes, 1.0), streamed_bytes / 1.0e6);
+        printf("\tTraffic with output RFO: normal stores %.2f MB in %.4f ms (%.3f GB/s), streaming stores %.2f MB in %.4f ms (%.3f GB/s)\n",
+            (model_bytes + y_bytes) / 1.0e6, normal_ms, (model_bytes + y_bytes) / normal_ms / 1.0e6,
+            (model_bytes + y_bytes - streamed_bytes) / 1.0e6, streaming_ms, (model_bytes + y_bytes - streamed_bytes) / streaming_ms / 1.0e6);
+    }
+
+    return streaming_ms;
+}
+
+
+/**
+ * Largest absolute difference between y and a reference, and the same
+ * relative to the reference's largest magnitude (a normwise error, which
+ * unlike elementwise relative error is not blown up by outputs that cancel
+ * to near zero)
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void SpmmErrors(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             num_vectors,
+    double                          &max_abs_error,
+    double                          &max_rel_error)
+{
+    double abs_error        = 0.0;
+    double max_reference    = 0.0;
+    size_t num_items        = size_t(a.num_rows) * num_vectors;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads) reduction(max:abs_error, max_reference)
+    for (long long i = 0; i < (long long) num_items; ++i)
+    {
+        abs_error       = std::max(abs_error, fabs(double(vector_y_out[i]) - double(reference_vector_y_out[i])));
+        max_reference   = std::max(max_reference, fabs(double(reference_vector_y_out[i])));
+    }
+
+    max_abs_error = abs_error;
+    max_rel_error = (max_reference > 0) ? abs_error / max_reference : abs_error;
+}
+
+
+/**
+ * Run OmpMergeCsrmm with X stored in fp32 and A, Y and all accumulation in
+ * ValueT.  Narrowing X is reported as setup time.  The test X is exactly
+ * representable in fp32, so the checked result differs from the full-
+ * precision reference by accumulation order only; the error report also
+ * multiplies an X that fp32 cannot hold (the test X plus 1/3) against its
+ * own full-precision reference, which shows the cost of rounding the inputs.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpMergeMixedCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms,
+    int                             num_vectors)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs, fp32 X, fp%d accumulation\n", g_omp_threads, omp_get_num_procs(), int(sizeof(ValueT) * 8));
+
+    size_t  x_items     = size_t(a.num_cols) * num_vectors;
+    int     ldx         = g_input_row_major ? num_vectors : a.num_cols;
+    int     ldy         = g_output_row_major ? num_vectors : a.num_rows;
+    float*  vector_x32  = (float*) mkl_malloc(sizeof(float) * x_items, 4096);
+
+    CpuTimer timer;
+    timer.Start();
+    #pragma omp parallel for schedule(static) num_threads(g_omp_threads)
+    for (long long i = 0; i < (long long) x_items; ++i)
+        vector_x32[i] = float(vector_x[i]);
+    timer.Stop();
+    setup_ms = timer.ElapsedMillis();
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
+    OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x32, ldx, vector_y_out, ldy, num_vectors, scratch, PlusTimes<ValueT>(), NoEpilogue());
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+
+        double abs_error, rel_error;
+        SpmmErrors(g_omp_threads, a, reference_vector_y_out, vector_y_out, num_vectors, abs_error, rel_error);
+        printf("\tError vs fp%d reference, fp32-exact X: %.3e max abs, %.3e normwise rel\n", int(sizeof(ValueT) * 8), abs_error, rel_error);
+
+        // Inexact X: rounding to fp32 now shows up
+        ValueT* x_inexact   = (ValueT*) mkl_malloc(sizeof(ValueT) * x_items, 4096);
+        float*  x32_inexact = (float*) mkl_malloc(sizeof(float) * x_items, 4096);
+        ValueT* reference   = (ValueT*) mkl_malloc(sizeof(ValueT) * a.num_rows * num_vectors, 4096);
+        for (size_t i = 0; i < x_items; ++i)
+        {
+            x_inexact[i]    = vector_x[i] + ValueT(1) / 3;
+            x32_inexact[i]  = float(x_inexact[i]);
+        }
+        SpmmGold(g_omp_threads, a, a.values, x_inexact, reference, num_vectors);
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, x32_inexact, ldx, vector_y_out, ldy, num_vectors, scratch, PlusTimes<ValueT>(), NoEpilogue());
+        SpmmErrors(g_omp_threads, a, reference, vector_y_out, num_vectors, abs_error, rel_error);
+        printf("\tError vs fp%d reference, inexact X:    %.3e max abs, %.3e normwise rel\n", int(sizeof(ValueT) * 8), abs_error, rel_error);
+        fflush(stdout);
+
+        mkl_free(x_inexact);
+        mkl_free(x32_inexact);
+        mkl_free(reference);
+    }
+
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x32, ldx, vector_y_out, ldy, num_vectors, scratch, PlusTimes<ValueT>(), NoEpilogue());
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x32, ldx, vector_y_out, ldy, num_vectors, scratch, PlusTimes<ValueT>(), NoEpilogue());
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    mkl_free(vector_x32);
+
+    return elapsed_ms / timing_iterations;
+}
+
+
+/**
+ * Apply an epilogue to every row of Y as a separate pass (the unfused
+ * baseline for the fused-epilogue kernels)
+ */
+template <
+    typename ValueT,
+    typename EpilogueT>
+void OmpEpiloguePass(
+    int                 num_threads,
+    const EpilogueT&    epilogue,
+    ValueT*             vector_y_out,
+    int                 num_rows,
+    int                 num_vectors)
+{
+    int y_stride        = g_output_row_major ? 1 : num_rows;
+    int y_row_stride    = g_output_row_major ? num_vectors : 1;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int row = 0; row < num_rows; ++row)
+        epilogue(row, vector_y_out + size_t(row) * y_row_stride, y_stride, num_vectors);
+}
+
+
+/**
+ * Run OmpMergeCsrmm as a GNN aggregation layer: Y = relu(scale * (A X) + bias),
+ * with A's values already normalized by the caller where needed.  Timed
+ * fused (returned) and as plain merge SpMM followed by one pass per epilogue
+ * stage (unfused_ms).  The fused result is checked against SpmmGold followed
+ * by the same epilogue passes.
+ */
+template <
+    typename ValueT,
+    typename OffsetT,
+    typename ScaleT>
+float TestOmpMergeGnnCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         values,
+    ScaleT                          scale,
+    ValueT*                         bias,
+    ValueT*                         vector_x,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &unfused_ms,
+    int                             num_vectors)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+
+    typedef SpmmEpilogue<ScaleT, NoBias<ValueT>, IdentityActivation<ValueT> >                       ScaleEpilogueT;
+    typedef SpmmEpilogue<NoRowScale<ValueT>, ColumnBias<ValueT>, IdentityActivation<ValueT> >       BiasEpilogueT;
+    typedef SpmmEpilogue<NoRowScale<ValueT>, NoBias<ValueT>, ReluActivation<ValueT> >               ReluEpilogueT;
+    typedef SpmmEpilogue<ScaleT, ColumnBias<ValueT>, ReluActivation<ValueT> >                       FusedEpilogueT;
+
+    ScaleEpilogueT  scale_epilogue(scale);
+    BiasEpilogueT   bias_epilogue = BiasEpilogueT(NoRowScale<ValueT>(), ColumnBias<ValueT>(bias));
+    ReluEpilogueT   relu_epilogue;
+    FusedEpilogueT  fused_epilogue(scale, ColumnBias<ValueT>(bias));
+
+    size_t  num_items   = size_t(a.num_rows) * num_vectors;
+    ValueT* reference   = (ValueT*) mkl_malloc(sizeof(ValueT) * num_items, 4096);
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * num_items);
+    OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, values, vector_x, vector_y_out, num_vectors, scratch, PlusTimes<ValueT>(), fused_epilogue);
+    if (!g_quiet)
+    {
+        // Check answer (all K columns) against SpmmGold followed by the epilogue stages
+        SpmmGold(g_omp_threads, a, values, vector_x, reference, num_vectors);
+        OmpEpiloguePass(g_omp_threads, scale_epilogue, reference, a.num_rows, num_vectors);
+        OmpEpiloguePass(g_omp_threads, bias_epilogue, reference, a.num_rows, num_vectors);
+        OmpEpiloguePass(g_omp_threads, relu_epilogue, reference, a.num_rows, num_vectors);
+
+        int compare = CompareSpmmResults(g_omp_threads, a, values, vector_x, reference, vector_y_out, num_vectors, fused_epilogue, true) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+
+    // Unfused timing
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, values, vector_x, reference, num_vectors, scratch);
+        OmpEpiloguePass(g_omp_threads, scale_epilogue, reference, a.num_rows, num_vectors);
+        OmpEpiloguePass(g_omp_threads, bias_epilogue, reference, a.num_rows, num_vectors);
+        OmpEpiloguePass(g_omp_threads, relu_epilogue, reference, a.num_rows, num_vectors);
+    }
+    timer.Stop();
+    unfused_ms = timer.ElapsedMillis() / timing_iterations;
+
+    // Fused timing
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, values, vector_x, vector_y_out, num_vectors, scratch, PlusTimes<ValueT>(), fused_epilogue);
+    }
+    timer.Stop();
+
+    mkl_free(reference);
+
+    return timer.ElapsedMillis() / timing_iterations;
+}
+
+
+/**
+ * Serial semiring SpMM with a row epilogue, one output value at a time (the
+ * reference for the semiring kernels)
+ */
+template <
+    typename ValueT,
+    typename OffsetT,
+    typename SemiringT,
+    typename EpilogueT>
+void SemiringCsrmmGold(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    const SemiringT&                /*semiring*/,
+    const EpilogueT&                epilogue,
+    ValueT*                         vector_x,
+    ValueT*                         vector_y_out,
+    int                             num_vectors)
+{
+    typedef ScalarTraits<ValueT> Scalar;
+
+    int x_row_stride    = g_input_row_major ? num_vectors : 1;
+    int x_stride        = g_input_row_major ? 1 : a.num_cols;
+    int y_stride        = g_output_row_major ? 1 : a.num_rows;
+    int y_row_stride    = g_output_row_major ? num_vectors : 1;
+
+    for (OffsetT row = 0; row < a.num_rows; ++row)
+    {
+        ValueT* y = vector_y_out + size_t(row) * y_row_stride;
+        for (int k = 0; k < num_vectors; ++k)
+        {
+            ValueT acc = SemiringT::Identity();
+            for (OffsetT nz = a.row_offsets[row]; nz < a.row_offsets[row + 1]; ++nz)
+                acc = SemiringT::template Accumulate<Scalar>(acc, a.values[nz], vector_x[size_t(a.column_indices[nz]) * x_row_stride + size_t(k) * x_stride]);
+            y[k * y_stride] = acc;
+        }
+        epilogue(row, y, y_stride, num_vectors);
+    }
+}
+
+
+/**
+ * Run OmpMergeCsrmm as a semiring aggregation (sum, mean, max or min of each
+ * row's neighbor features), checked against SemiringCsrmmGold over all K
+ * columns with CompareSpmmResults' per-output tolerances (which also bound
+ * max and min, whose error cannot exceed that of the sum)
+ */
+template <
+    typename ValueT,
+    typename OffsetT,
+    typename SemiringT,
+    typename EpilogueT>
+float TestOmpMergeSemiringCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    const SemiringT&                semiring,
+    const EpilogueT&                epilogue,
+    ValueT*                         vector_x,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    int                             num_vectors)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+
+    size_t  num_items   = size_t(a.num_rows) * num_vectors;
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * num_items);
+    OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch, semiring, epilogue);
+    if (!g_quiet)
+    {
+        // Check answer (all K columns)
+        ValueT* reference = (ValueT*) mkl_malloc(sizeof(ValueT) * num_items, 4096);
+        SemiringCsrmmGold(a, semiring, epilogue, vector_x, reference, num_vectors);
+        int compare = CompareSpmmResults(g_omp_threads, a, a.values, vector_x, reference, vector_y_out, num_vectors, epilogue, true) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+        mkl_free(reference);
+    }
+
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch, semiring, epilogue);
+    }
+
+    // Timing
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, scratch, semiring, epilogue);
+    }
+    timer.Stop();
+
+    return timer.ElapsedMillis() / timing_iterations;
+}
+
+/**
+ * OpenMP CPU merge-based SpMM, blocked over K.  Each thread finds its merge
+ * path segment once and then sweeps it once per k_panel-wide column panel of
+ * X and Y, so the X rows it gathers are k_panel values wide instead of
+ * num_vectors.  With k_panel a multiple of 64 every output column sees the
+ * same tile and FMA sequence as in OmpMergeCsrmm, so results are identical.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMergePanelCsrmm(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    ValueT*     __restrict        values,
+    ValueT*     __restrict        vector_y_out,
+    int                           num_vectors,
+    ValueT*     __restrict        vector_x_row_major,
+    SpmmScratch<ValueT, OffsetT>& scratch,            ///< Per-thread carry-outs for inter-thread fix-up after load-balanced work
+    int                           k_panel)            ///< Columns of X and Y per panel
+{
+    scratch.Reserve(num_threads, num_vectors);
+
+    int y_stride        = g_output_row_major ? 1 : a.num_rows;
+    int y_row_stride    = g_output_row_major ? num_vectors : 1;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        // Merge list B (NZ indices)
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+
+        OffsetT num_merge_items     = a.num_rows + a.num_nonzeros;                          // Merge path total length
+        OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;    // Merge items per thread
+
+        // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
+        int2    thread_coord_begin;
+        int2    thread_coord_end;
+        int     start_diagonal      = std::min(items_per_thread * tid, num_merge_items);
+        int     end_diagonal        = std::min(start_diagonal + items_per_thread, num_merge_items);
+
+        MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord_begin);
+        MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord_end);
+
+        for (int k = 0; k < num_vectors; k += k_panel)
+        {
+            int     panel_width     = std::min(k_panel, num_vectors - k);
+            int2    thread_coord    = thread_coord_begin;
+
+            // Consume whole rows
+            for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+            {
+                SpmmRow(column_indices, values, thread_coord.y, row_end_offsets[thread_coord.x], vector_x_row_major + k, num_vectors, panel_width, vector_y_out + thread_coord.x * y_row_stride + k * y_stride, y_stride);
+                thread_coord.y = row_end_offsets[thread_coord.x];
+            }
+
+            // Consume partial portion of thread's last row
+            SpmmRow(column_indices, values, thread_coord.y, thread_coord_end.y, vector_x_row_major + k, num_vectors, panel_width, scratch.Carry(tid) + k, 1);
+        }
+
+        // Save carry-outs
+        scratch.CarryRow(tid) = thread_coord_end.x;
+    }
+
+    // Carry-out fix-up (rows spanning multiple threads)
+    for (int tid = 0; tid < num_threads - 1; ++tid)
+    {
+        if (scratch.CarryRow(tid) < a.num_rows)
+        {
+            ValueT* y       = vector_y_out + scratch.CarryRow(tid) * y_row_stride;
+            ValueT* carry   = scratch.Carry(tid);
+            for (int i = 0; i < num_vectors; ++i)
+                y[i * y_stride] += carry[i];
+        }
+    }
+}
+
+
+/**
+ * Run OmpMergePanelCsrmm
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpMergePanelCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms,
+    int                             num_vectors,
+    ValueT*                         vector_x_row_major,
+    int                             k_panel)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    // Column-major X is converted once, outside the timed loop
+    setup_ms = g_input_row_major ? 0.0 : ConvertInputToRowMajor(g_omp_threads, vector_x_row_major, vector_x, a.num_cols, num_vectors);
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs, %d-column K-panels\n", g_omp_threads, omp_get_num_procs(), k_panel);
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
+    OmpMergePanelCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_y_out, num_vectors, vector_x_row_major, scratch, k_panel);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergePanelCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_y_out, num_vectors, vector_x_row_major, scratch, k_panel);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergePanelCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_y_out, num_vectors, vector_x_row_major, scratch, k_panel);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    return elapsed_ms / timing_iterations;
+}
+
+/**
+ * Grid shape for OmpMerge2dCsrmm: x merge-path segments by y chunks of K.
+ * The path is split first, since every extra K chunk re-reads A; K is only
+ * split once a path segment would fall below min_items merge items, and
+ * never into chunks narrower than min_k columns.
+ */
+int2 Merge2dGrid(
+    int     num_rows,
+    int     num_nonzeros,
+    int     num_vectors,
+    int     num_threads)
+{
+    const long long min_items   = 4096;     // Rows + nonzeros per path segment worth a thread of its own
+    const int       min_k       = 16;       // Narrowest K chunk (two AVX-512 fp64 tiles)
+
+    long long num_merge_items = (long long) num_rows + num_nonzeros;
+
+    int2 grid;
+    grid.x = (int) std::max(1LL, std::min((long long) num_threads, num_merge_items / min_items));
+    grid.y = std::max(1, std::min(num_threads / grid.x, num_vectors / min_k));
+    grid.x = num_threads / grid.y;
+    return grid;
+}
+
+
+/**
+ * Columns [k_begin, k_begin + k_width) of K chunk chunk of num_chunks.  The
+ * ceil(num_vectors / 8) tiles of 8 columns are spread as evenly as possible
+ * over the chunks, so chunk widths are multiples of 8 (except for the last
+ * chunk's ragged tail) and differ by at most one tile.
+ */
+inline void Merge2dChunk(
+    int     chunk,
+    int     num_chunks,
+    int     num_vectors,
+    int     &k_begin,
+    int     &k_width)
+{
+    int num_tiles   = (num_vectors + 7) / 8;
+    int tile_begin  = int((long long) num_tiles * chunk / num_chunks);
+    int tile_end    = int((long long) num_tiles * (chunk + 1) / num_chunks);
+
+    k_begin = std::min(tile_begin * 8, num_vectors);
+    k_width = std::min(tile_end * 8, num_vectors) - k_begin;
+}
+
+
+/**
+ * OpenMP CPU merge-based SpMM over a 2D grid of merge-path segments x K
+ * chunks.  Thread (p, q) runs path segment p over the columns of chunk q
+ * (see Merge2dChunk).  Carry-outs are kept per thread and fixed up per
+ * chunk.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMerge2dCsrmm(
+    int2                            grid,               ///< Merge-path segments (x) by K chunks (y)
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    ValueT*     __restrict        values,
+    ValueT*     __restrict        vector_y_out,
+    int                           num_vectors,
+    ValueT*     __restrict        vector_x_row_major,
+    SpmmScratch<ValueT, OffsetT>& scratch)            ///< Per-thread carry-outs for inter-thread fix-up after load-balanced work
+{
+    int num_threads = grid.x * grid.y;
+
+    scratch.Reserve(num_threads, num_vectors);
+
+    int y_stride        = g_output_row_major ? 1 : a.num_rows;
+    int y_row_stride    = g_output_row_major ? num_vectors : 1;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        int path_id     = tid / grid.y;
+        int k_begin, k_width;
+        Merge2dChunk(tid % grid.y, grid.y, num_vectors, k_begin, k_width);
+
+        // Merge list B (NZ indices)
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+
+        OffsetT num_merge_items     = a.num_rows + a.num_nonzeros;                          // Merge path total length
+        OffsetT items_per_thread    = (num_merge_items + grid.x - 1) / grid.x;              // Merge items per path segment
+
+        // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for this segment
+        int2    thread_coord;
+        int2    thread_coord_end;
+        int     start_diagonal      = std::min(items_per_thread * path_id, num_merge_items);
+        int     end_diagonal        = std::min(start_diagonal + items_per_thread, num_merge_items);
+
+        MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord);
+        MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord_end);
+
+        // Consume whole rows
+        for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+        {
+            SpmmRow(column_indices, values, thread_coord.y, row_end_offsets[thread_coord.x], vector_x_row_major + k_begin, num_vectors, k_width, vector_y_out + thread_coord.x * y_row_stride + k_begin * y_stride, y_stride);
+            thread_coord.y = row_end_offsets[thread_coord.x];
+        }
+
+        // Consume partial portion of the segment's last row
+        SpmmRow(column_indices, values, thread_coord.y, thread_coord_end.y, vector_x_row_major + k_begin, num_vectors, k_width, scratch.Carry(tid), 1);
+
+        // Save carry-outs
+        scratch.CarryRow(tid) = thread_coord_end.x;
+    }
+
+    // Carry-out fix-up (rows spanning multiple path segments), per K chunk
+    for (int tid = 0; tid < num_threads - grid.y; ++tid)
+    {
+        if (scratch.CarryRow(tid) < a.num_rows)
+        {
+            int     k_begin, k_width;
+            Merge2dChunk(tid % grid.y, grid.y, num_vectors, k_begin, k_width);
+            ValueT* y       = vector_y_out + scratch.CarryRow(tid) * y_row_stride + k_begin * y_stride;
+            ValueT* carry   = scratch.Carry(tid);
+            for (int i = 0; i < k_width; ++i)
+                y[i * y_stride] += carry[i];
+        }
+    }
+}
+
+
+/**
+ * Run OmpMerge2dCsrmm
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpMerge2dCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms,
+    int                             num_vectors,
+    ValueT*                         vector_x_row_major)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    // Column-major X is converted once, outside the timed loop
+    setup_ms = g_input_row_major ? 0.0 : ConvertInputToRowMajor(g_omp_threads, vector_x_row_major, vector_x, a.num_cols, num_vectors);
+
+    int2 grid = Merge2dGrid(a.num_rows, a.num_nonzeros, num_vectors, g_omp_threads);
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs, %d path segments x %d K chunks\n", grid.x * grid.y, omp_get_num_procs(), grid.x, grid.y);
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(grid.x * grid.y, num_vectors);
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
+    OmpMerge2dCsrmm(grid, a, a.row_offsets + 1, a.column_indices, a.values, vector_y_out, num_vectors, vector_x_row_major, scratch);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMerge2dCsrmm(grid, a, a.row_offsets + 1, a.column_indices, a.values, vector_y_out, num_vectors, vector_x_row_major, scratch);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMerge2dCsrmm(grid, a, a.row_offsets + 1, a.column_indices, a.values, vector_y_out, num_vectors, vector_x_row_major, scratch);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    return elapsed_ms / timing_iterations;
+}
+
+/**
+ * Computes the row (x) that nonzero path_coordinate.y falls in: the first row
+ * whose end-offset is past it, or a_len once y reaches the end.  Nonzero 0
+ * maps to row 0 so that leading empty rows are not skipped.
+ */
+template <
+    typename AIteratorT,
+    typename BIteratorT,
+    typename OffsetT,
+    typename CoordinateT>
+inline void RowPathSearch(
+    AIteratorT      a,                  ///< [in]List A
+    BIteratorT      b,                  ///< [in]List B
+    OffsetT         a_len,              ///< [in]Length of A
+    CoordinateT&    path_coordinate)    ///< [out] (x,y) coordinate where diagonal intersects the merge path
+{
+    OffsetT x_min = 0;
+    OffsetT x_max = (path_coordinate.y > 0) ? a_len : 0;
+
+    while (x_min < x_max)
+    {
+        OffsetT x_pivot = (x_min + x_max) >> 1;
+        if (a[x_pivot] <= b[path_coordinate.y])
+            x_min = x_pivot + 1;    // Contract range up A (down B)
+        else
+            x_max = x_pivot;        // Contract range down A (up B)
+    }
+
+    path_coordinate.x = std::min(x_min, a_len);
+}
+
+/**
+ * OpenMP CPU row-based SpMM.  X must be row-major; X and Y are read and
+ * written with leading dimensions ldx and ldy, so both may be views into
+ * wider matrices.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpNonzeroSplitCsrmm(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    ValueT*     __restrict        values,
+    ValueT*     __restrict        vector_x_row_major,
+    int                           ldx,                ///< Leading dimension of (row-major) X
+    ValueT*     __restrict        vector_y_out,
+    int                           ldy,                ///< Leading dimension of Y
+    int                           num_vectors,
+    SpmmScratch<ValueT, OffsetT>& scratch)            ///< Per-thread carry-outs for inter-thread fix-up after load-balanced work
+{
+    scratch.Reserve(num_threads, num_vectors);
+
+    int y_stride        = g_output_row_major ? 1 : ldy;
+    int y_row_stride    = g_output_row_major ? ldy : 1;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        // Merge list B (NZ indices)
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+
+        OffsetT num_nonzeros     = a.num_nonzeros;                          
+        OffsetT items_per_thread    = (num_nonzeros + num_threads - 1) / num_threads;
+
+        // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
+        int2    thread_coord;
+        int2    thread_coord_end;
+        thread_coord.y            = std::min(items_per_thread * tid, num_nonzeros);
+        thread_coord_end.y        = std::min(thread_coord.y + items_per_thread, num_nonzeros);
+
+        RowPathSearch(row_end_offsets, nonzero_indices, a.num_rows, thread_coord);
+        RowPathSearch(row_end_offsets, nonzero_indices, a.num_rows, thread_coord_end);
+
+        // Consume whole rows
+        for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+        {
+            SpmmRow(column_indices, values, thread_coord.y, row_end_offsets[thread_coord.x], vector_x_row_major, ldx, num_vectors, vector_y_out + size_t(thread_coord.x) * y_row_stride, y_stride);
+            thread_coord.y = row_end_offsets[thread_coord.x];
+        }
+
+        // Consume partial portion of thread's last row
+        SpmmRow(column_indices, values, thread_coord.y, thread_coord_end.y, vector_x_row_major, ldx, num_vectors, scratch.Carry(tid), 1);
+
+        // Save carry-outs
+        scratch.CarryRow(tid) = thread_coord_end.x;
+    }
+
+    // Carry-out fix-up (rows spanning multiple threads)
+    for (int tid = 0; tid < num_threads - 1; ++tid)
+    {
+        if (scratch.CarryRow(tid) < a.num_rows)
+        {
+            ValueT* y       = vector_y_out + size_t(scratch.CarryRow(tid)) * y_row_stride;
+            ValueT* carry   = scratch.Carry(tid);
+            for (int i = 0; i < num_vectors; ++i)
+                y[i * y_stride] += carry[i];
+        }
+    }
+}
+
+
+/**
+ * OpenMP CPU row-based SpMM on packed X and Y
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpNonzeroSplitCsrmm(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    ValueT*     __restrict        values,
+    ValueT*     __restrict        vector_y_out,
+    int                           num_vectors,
+    ValueT*     __restrict        vector_x_row_major,
+    SpmmScratch<ValueT, OffsetT>& scratch)            ///< Per-thread carry-outs for inter-thread fix-up after load-balanced work
+{
+    int ldy = g_output_row_major ? num_vectors : a.num_rows;
+    OmpNonzeroSplitCsrmm(num_threads, a, row_end_offsets, column_indices, values, vector_x_row_major, num_vectors, vector_y_out, ldy, num_vectors, scratch);
+}
+
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpNonzeroSplitCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms,
+    int                             num_vectors,
+    ValueT*                         vector_x_row_major)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    // Column-major X is converted once, outside the timed loop
+    setup_ms = g_input_row_major ? 0.0 : ConvertInputToRowMajor(g_omp_threads, vector_x_row_major, vector_x, a.num_cols, num_vectors);
+    int num_threads = g_omp_threads;
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
+    OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_y_out, num_vectors, vector_x_row_major, scratch);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+    
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_y_out, num_vectors, vector_x_row_major, scratch);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_y_out, num_vectors, vector_x_row_major, scratch);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    return elapsed_ms / timing_iterations;
+}
+
+//---------------------------------------------------------------------
+// CPU SpMM on strided views
+//---------------------------------------------------------------------
+
+/**
+ * Copy a num_rows x num_vectors matrix in the given layout between buffers
+ * with leading dimensions ld_from and ld_to
+ */
+template <typename ValueT>
+void CopyStridedMatrix(
+    int             num_threads,
+    ValueT*         to,
+    int             ld_to,
+    const ValueT*   from,
+    int             ld_from,
+    int             num_rows,
+    int             num_vectors,
+    bool            row_major)
+{
+    int outer = row_major ? num_rows : num_vectors;
+    int inner = row_major ? num_vectors : num_rows;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int i = 0; i < outer; ++i)
+        memcpy(to + size_t(i) * ld_to, from + size_t(i) * ld_from, sizeof(ValueT) * inner);
+}
+
+
+/**
+ * Run OmpMergeCsrmm and OmpNonzeroSplitCsrmm on X and Y views placed inside
+ * operands ld_pad elements wider along their leading dimension.  X's padding
+ * holds NaNs, so a read outside the view fails the check, and Y's padding
+ * must come back untouched.  The strided merge kernel is timed against
+ * staging the same views through packed copies (staged_ms).
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpStridedCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    int                             ld_pad,
+    float                           &staged_ms,
+    int                             num_vectors)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs, leading dimensions padded by %d\n", g_omp_threads, omp_get_num_procs(), ld_pad);
+
+    int     packed_ldx      = g_input_row_major ? num_vectors : a.num_cols;
+    int     packed_ldy      = g_output_row_major ? num_vectors : a.num_rows;
+    int     ldx             = packed_ldx + ld_pad;
+    int     ldx_row_major   = num_vectors + ld_pad;             // Nonzero splitting reads row-major X only
+    int     ldy             = packed_ldy + ld_pad;
+    int     view_offset     = ld_pad / 2;
+    size_t  x_items         = size_t(a.num_cols) * num_vectors;
+    size_t  x_wide_items    = size_t(ldx) * (x_items / packed_ldx);
+    size_t  x_rm_wide_items = size_t(ldx_row_major) * a.num_cols;
+    size_t  y_wide_items    = size_t(ldy) * ((size_t(a.num_rows) * num_vectors) / packed_ldy);
+
+    ValueT* x_wide          = (ValueT*) mkl_malloc(sizeof(ValueT) * x_wide_items, 4096);
+    ValueT* x_rm_wide       = (ValueT*) mkl_malloc(sizeof(ValueT) * x_rm_wide_items, 4096);
+    ValueT* y_wide          = (ValueT*) mkl_malloc(sizeof(ValueT) * y_wide_items, 4096);
+    ValueT* x_packed        = (ValueT*) mkl_malloc(sizeof(ValueT) * x_items, 4096);    // Staging buffer
+    ValueT* x_view          = x_wide + view_offset;
+    ValueT* x_rm_view       = x_rm_wide + view_offset;
+    ValueT* y_view          = y_wide + view_offset;
+
+    std::fill(x_wide, x_wide + x_wide_items, std::numeric_limits<ValueT>::quiet_NaN());
+    std::fill(x_rm_wide, x_rm_wide + x_rm_wide_items, std::numeric_limits<ValueT>::quiet_NaN());
+    CopyStridedMatrix(g_omp_threads, x_view, ldx, vector_x, packed_ldx, a.num_cols, num_vectors, g_input_row_major);
+    for (OffsetT col = 0; col < a.num_cols; ++col)
+        for (int k = 0; k < num_vectors; ++k)
+            x_rm_view[size_t(col) * ldx_row_major + k] = SpmmInputValue<ValueT>(col, k);
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+
+    // Warmup/correctness (both kernels)
+    const ValueT    y_pad   = ValueT(-7);
+    const char*     names[] = {"Merge", "Nonzero splitting"};
+    for (int kernel = 0; kernel < 2; ++kernel)
+    {
+        std::fill(y_wide, y_wide + y_wide_items, y_pad);
+        if (kernel == 0)
+            OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, x_view, ldx, y_view, ldy, num_vectors, scratch);
+        else
+            OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, x_rm_view, ldx_row_major, y_view, ldy, num_vectors, scratch);
+
+        if (!g_quiet)
+        {
+            // Check answer, and that nothing outside the Y view was written
+            int     inner       = g_output_row_major ? num_vectors : a.num_rows;
+            size_t  clobbered   = 0;
+            for (size_t i = 0; i < y_wide_items; ++i)
+            {
+                int offset = int(i % ldy);
+                if (((offset < view_offset) || (offset >= view_offset + inner)) && (y_wide[i] != y_pad))
+                    ++clobbered;
+            }
+
+            CopyStridedMatrix(g_omp_threads, vector_y_out, packed_ldy, y_view, ldy, a.num_rows, num_vectors, g_output_row_major);
+            int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
+            if (clobbered)
+                printf("\t%lu padding elements of Y overwritten\n", (unsigned long) clobbered);
+            printf("\t%s: %s\n", names[kernel], (compare || clobbered) ? "FAIL" : "PASS"); fflush(stdout);
+        }
+    }
+
+    // Staged timing (pack the X view, packed SpMM, unpack into the Y view)
+    CpuTimer timer;
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        CopyStridedMatrix(g_omp_threads, x_packed, packed_ldx, x_view, ldx, a.num_cols, num_vectors, g_input_row_major);
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, x_packed, vector_y_out, num_vectors, scratch);
+        CopyStridedMatrix(g_omp_threads, y_view, ldy, vector_y_out, packed_ldy, a.num_rows, num_vectors, g_output_row_major);
+    }
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        CopyStridedMatrix(g_omp_threads, x_packed, packed_ldx, x_view, ldx, a.num_cols, num_vectors, g_input_row_major);
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, x_packed, vector_y_out, num_vectors, scratch);
+        CopyStridedMatrix(g_omp_threads, y_view, ldy, vector_y_out, packed_ldy, a.num_rows, num_vectors, g_output_row_major);
+    }
+    timer.Stop();
+    staged_ms = timer.ElapsedMillis() / timing_iterations;
+
+    // Strided timing
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, x_view, ldx, y_view, ldy, num_vectors, scratch);
+    }
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, x_view, ldx, y_view, ldy, num_vectors, scratch);
+    }
+    timer.Stop();
+
+    mkl_free(x_wide);
+    mkl_free(x_rm_wide);
+    mkl_free(y_wide);
+    mkl_free(x_packed);
+
+    return timer.ElapsedMillis() / timing_iterations;
+}
+
+
+//---------------------------------------------------------------------
+// CPU batched merge-based SpMM
+//---------------------------------------------------------------------
+
+/**
+ * Merge-path partition of a CSR matrix: each thread's starting (row-idx,
+ * nonzero-idx) coordinate, with entry num_threads the end of the path.  It
+ * depends only on the sparsity pattern, so one plan serves every value array
+ * (and every X) that shares it.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+struct MergePathPlan
+{
+    int                 num_threads;
+    std::vector<int2>   thread_coord;   // [num_threads + 1]
+
+    MergePathPlan(
+        CsrMatrix<ValueT, OffsetT>&     a,
+        int                             num_threads)
+    :
+        num_threads(num_threads),
+        thread_coord(num_threads + 1)
+    {
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+        OffsetT num_merge_items     = a.num_rows + a.num_nonzeros;
+        OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;
+
+        for (int tid = 0; tid <= num_threads; ++tid)
+            MergePathSearch(std::min(items_per_thread * tid, num_merge_items), a.row_offsets + 1, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord[tid]);
+    }
+};
+
+
+/**
+ * OpenMP CPU merge-based SpMM over a batch of batch_size problems that share
+ * A's sparsity pattern: Y_b = A_b X_b.  Everything is interleaved by batch
+ * entry: values_batch[nz * batch_size + b] is A_b's nonzero nz, and row c of
+ * X holds X_0(c, :), X_1(c, :), ... back to back (likewise Y).  A nonzero's
+ * column index is then read once per microkernel tile, which covers a
+ * contiguous run of the batch_size * num_vectors block of X across problems,
+ * the way SpMM amortizes it over a num_vectors block.  The merge path
+ * partition comes from a plan built once for the pattern.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMergeBatchedCsrmm(
+    MergePathPlan<ValueT, OffsetT>&     plan,
+    CsrMatrix<ValueT, OffsetT>&         a,
+    ValueT*     __restrict              values_batch,       ///< [num_nonzeros x batch_size] interleaved values
+    ValueT*     __restrict              vector_x_batch,     ///< [num_cols x batch_size x num_vectors] batch-interleaved X
+    ValueT*     __restrict              vector_y_batch,     ///< [num_rows x batch_size x num_vectors] batch-interleaved Y
+    int                                 num_vectors,
+    int                                 batch_size,
+    SpmmScratch<ValueT, OffsetT>&       scratch)            ///< Per-thread carry-outs (num_vectors per batch entry)
+{
+    int num_threads = plan.num_threads;
+    scratch.Reserve(num_threads, num_vectors * batch_size);
+
+    OffsetT*    row_end_offsets = a.row_offsets + 1;
+    int         ldx             = num_vectors * batch_size;
+    int         ldy             = num_vectors * batch_size;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        int2 thread_coord       = plan.thread_coord[tid];
+        int2 thread_coord_end   = plan.thread_coord[tid + 1];
+
+        // Consume whole rows
+        for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+        {
+            SpmmBatchRow(a.column_indices, values_batch, batch_size, thread_coord.y, row_end_offsets[thread_coord.x], vector_x_batch, ldx, num_vectors, vector_y_batch + size_t(thread_coord.x) * ldy);
+            thread_coord.y = row_end_offsets[thread_coord.x];
+        }
+
+        // Consume partial portion of thread's last row
+        SpmmBatchRow(a.column_indices, values_batch, batch_size, thread_coord.y, thread_coord_end.y, vector_x_batch, ldx, num_vectors, scratch.Carry(tid));
+
+        // Save carry-outs
+        scratch.CarryRow(tid) = thread_coord_end.x;
+    }
+
+    // Carry-out fix-up (rows spanning multiple threads)
+    for (int tid = 0; tid < num_threads - 1; ++tid)
+    {
+        if (scratch.CarryRow(tid) < a.num_rows)
+        {
+            ValueT* y       = vector_y_batch + size_t(scratch.CarryRow(tid)) * ldy;
+            ValueT* carry   = scratch.Carry(tid);
+            for (int i = 0; i < ldy; ++i)
+                y[i] += carry[i];
+        }
+    }
+}
+
+
+/**
+ * Run OmpMergeBatchedCsrmm on batch_size value arrays and right-hand sides
+ * generated from A, against batch_size back-to-back OmpMergeCsrmm calls on
+ * separate X and Y matrices in the selected layouts (sequential_ms).
+ * Building the plan is the setup; the batch-interleaved values and X are
+ * taken as given.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpMergeBatchedCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    int                             batch_size,
+    int                             timing_iterations,
+    float                           &setup_ms,
+    float                           &sequential_ms,
+    int                             num_vectors)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs, batch of %d\n", g_omp_threads, omp_get_num_procs(), batch_size);
+
+    size_t  x_items             = size_t(a.num_cols) * num_vectors;
+    size_t  y_items             = size_t(a.num_rows) * num_vectors;
+    int     ldx                 = num_vectors * batch_size;
+    ValueT* values_batch        = (ValueT*) mkl_malloc(sizeof(ValueT) * a.num_nonzeros * batch_size, 4096);    // Separate A_b values
+    ValueT* x_batch             = (ValueT*) mkl_malloc(sizeof(ValueT) * x_items * batch_size, 4096);           // Separate X_b, selected layout
+    ValueT* y_batch             = (ValueT*) mkl_malloc(sizeof(ValueT) * y_items * batch_size, 4096);           // Separate Y_b, selected layout
+    ValueT* values_interleaved  = (ValueT*) mkl_malloc(sizeof(ValueT) * a.num_nonzeros * batch_size, 4096);
+    ValueT* x_interleaved       = (ValueT*) mkl_malloc(sizeof(ValueT) * x_items * batch_size, 4096);
+    ValueT* y_interleaved       = (ValueT*) mkl_malloc(sizeof(ValueT) * y_items * batch_size, 4096);
+
+    // A_b scales A's values by a per-nonzero, per-problem factor; X_b shifts the test input's columns
+    for (int b = 0; b < batch_size; ++b)
+    {
+        for (OffsetT nz = 0; nz < a.num_nonzeros; ++nz)
+        {
+            values_batch[size_t(b) * a.num_nonzeros + nz]       = a.values[nz] * ValueT(1 + (nz + b) % 5) / 4;
+            values_interleaved[size_t(nz) * batch_size + b]     = values_batch[size_t(b) * a.num_nonzeros + nz];
+        }
+
+        for (int col = 0; col < a.num_cols; ++col)
+        {
+            for (int k = 0; k < num_vectors; ++k)
+            {
+                size_t i = g_input_row_major ? size_t(col) * num_vectors + k : size_t(k) * a.num_cols + col;
+                x_batch[b * x_items + i]                                = SpmmInputValue<ValueT>(col, k + b);
+                x_interleaved[size_t(col) * ldx + b * num_vectors + k]  = SpmmInputValue<ValueT>(col, k + b);
+            }
+        }
+    }
+
+    // Plan once for the whole batch
+    CpuTimer timer;
+    timer.Start();
+    MergePathPlan<ValueT, OffsetT> plan(a, g_omp_threads);
+    timer.Stop();
+    setup_ms = timer.ElapsedMillis();
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors * batch_size);
+
+    // Warmup/correctness
+    memset(y_interleaved, -1, sizeof(ValueT) * y_items * batch_size);
+    OmpMergeBatchedCsrmm(plan, a, values_interleaved, x_interleaved, y_interleaved, num_vectors, batch_size, scratch);
+    if (!g_quiet)
+    {
+        // Check answer (every problem in the batch, de-interleaved into the selected output layout)
+        ValueT* reference   = (ValueT*) mkl_malloc(sizeof(ValueT) * y_items, 4096);
+        int     compare     = 0;
+        for (int b = 0; (b < batch_size) && !compare; ++b)
+        {
+            ValueT* y = y_batch + b * y_items;
+            for (OffsetT row = 0; row < a.num_rows; ++row)
+            {
+                for (int k = 0; k < num_vectors; ++k)
+                {
+                    size_t i = g_output_row_major ? size_t(row) * num_vectors + k : size_t(k) * a.num_rows + row;
+                    y[i] = y_interleaved[size_t(row) * ldx + b * num_vectors + k];
+                }
+            }
+
+            SpmmGold(g_omp_threads, a, values_batch + size_t(b) * a.num_nonzeros, x_batch + b * x_items, reference, num_vectors);
+            compare = CompareSpmmResults(g_omp_threads, a, values_batch + size_t(b) * a.num_nonzeros, x_batch + b * x_items, reference, y, num_vectors) != 0;
+            if (compare)
+                printf("\t(batch entry %d)\n", b);
+        }
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+        mkl_free(reference);
+    }
+
+    // Sequential timing (one merge SpMM per problem, each with its own path search)
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        for (int b = 0; b < batch_size; ++b)
+            OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, values_batch + size_t(b) * a.num_nonzeros, x_batch + b * x_items, y_batch + b * y_items, num_vectors, scratch);
+    }
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        for (int b = 0; b < batch_size; ++b)
+            OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, values_batch + size_t(b) * a.num_nonzeros, x_batch + b * x_items, y_batch + b * y_items, num_vectors, scratch);
+    }
+    timer.Stop();
+    sequential_ms = timer.ElapsedMillis() / timing_iterations;
+
+    // Batched timing
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeBatchedCsrmm(plan, a, values_interleaved, x_interleaved, y_interleaved, num_vectors, batch_size, scratch);
+    }
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeBatchedCsrmm(plan, a, values_interleaved, x_interleaved, y_interleaved, num_vectors, batch_size, scratch);
+    }
+    timer.Stop();
+
+    mkl_free(values_batch);
+    mkl_free(x_batch);
+    mkl_free(y_batch);
+    mkl_free(values_interleaved);
+    mkl_free(x_interleaved);
+    mkl_free(y_interleaved);
+
+    return timer.ElapsedMillis() / timing_iterations;
+}
+
+
+//---------------------------------------------------------------------
+// CPU symmetric SpMM
+//---------------------------------------------------------------------
+
+/**
+ * Upper-triangle storage and thread schedule for symmetric SpMM.  Threads own
+ * contiguous row ranges of the triangle, split along its merge path.  Each
+ * stored entry (r, c) updates Y row r and, mirrored, Y row c > r; mirrored
+ * updates that fall past the end of the thread's range go to a private spill
+ * block covering rows [row_end, spill_end), which the owning threads add in
+ * afterwards.  For banded matrices the spill blocks are about one bandwidth
+ * tall.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+struct SymmetricSpmmPlan
+{
+    CsrMatrix<ValueT, OffsetT>*     upper;
+    int                             num_threads;
+    std::vector<OffsetT>            row_begin;      // [num_threads + 1] first row of each thread
+    std::vector<OffsetT>            spill_end;      // [num_threads] one past the last mirrored row of each thread
+    std::vector<ValueT*>            spill;          // [num_threads] row-major (spill_end - row_end) x num_vectors blocks
+
+
+    SymmetricSpmmPlan(
+        CsrMatrix<ValueT, OffsetT>&     a,
+        int                             num_threads,
+        int                             num_vectors)
+    :
+        num_threads(num_threads),
+        row_begin(num_threads + 1),
+        spill_end(num_threads),
+        spill(num_threads)
+    {
+        CooMatrix<ValueT, OffsetT> coo_upper;
+        coo_upper.InitCsrTriangle(a);
+        upper = new CsrMatrix<ValueT, OffsetT>(coo_upper);
+
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+        OffsetT num_merge_items     = upper->num_rows + upper->num_nonzeros;
+        OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;
+
+        for (int tid = 0; tid < num_threads; ++tid)
+        {
+            int2 thread_coord;
+            MergePathSearch(std::min(items_per_thread * tid, num_merge_items), upper->row_offsets + 1, nonzero_indices, upper->num_rows, upper->num_nonzeros, thread_coord);
+            row_begin[tid] = thread_coord.x;
+        }
+        row_begin[num_threads] = upper->num_rows;
+
+        for (int tid = 0; tid < num_threads; ++tid)
+        {
+            // Columns are sorted within each row
+            spill_end[tid] = row_begin[tid + 1];
+            for (OffsetT row = row_begin[tid]; row < row_begin[tid + 1]; ++row)
+            {
+                if (upper->row_offsets[row] < upper->row_offsets[row + 1])
+                    spill_end[tid] = std::max(spill_end[tid], upper->column_indices[upper->row_offsets[row + 1] - 1] + 1);
+            }
+
+            size_t spill_items = size_t(std::max(OffsetT(1), SpillRows(tid))) * num_vectors;
+            spill[tid] = (ValueT*) mkl_malloc(sizeof(ValueT) * spill_items, 4096);
+        }
+    }
+
+
+    ~SymmetricSpmmPlan()
+    {
+        for (int tid = 0; tid < num_threads; ++tid)
+            mkl_free(spill[tid]);
+        delete upper;
+    }
+
+
+    OffsetT SpillRows(int tid)
+    {
+        return spill_end[tid] - row_begin[tid + 1];
+    }
+};
+
+
+/**
+ * OpenMP CPU symmetric SpMM over upper-triangle storage.  X must be row-major;
+ * Y is written in the layout selected by g_output_row_major.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpSymmetricCsrmm(
+    int                                 num_threads,
+    SymmetricSpmmPlan<ValueT, OffsetT>& plan,
+    ValueT*     __restrict              vector_x_row_major,
+    ValueT*     __restrict              vector_y_out,
+    int                                 num_vectors,
+    SpmmScratch<ValueT, OffsetT>&       scratch)
+{
+    CsrMatrix<ValueT, OffsetT>& u = *plan.upper;
+
+    scratch.Reserve(num_threads, num_vectors);
+
+    int y_stride        = g_output_row_major ? 1 : u.num_rows;
+    int y_row_stride    = g_output_row_major ? num_vectors : 1;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        OffsetT row_begin   = plan.row_begin[tid];
+        OffsetT row_end     = plan.row_begin[tid + 1];
+        ValueT* spill       = plan.spill[tid];
+        ValueT* row_total   = scratch.Carry(tid);
+
+        for (OffsetT row = row_begin; row < row_end; ++row)
+        {
+            ValueT* y = vector_y_out + row * y_row_stride;
+            for (int i = 0; i < num_vectors; ++i)
+                y[i * y_stride] = 0.0;
+        }
+        memset(spill, 0, sizeof(ValueT) * plan.SpillRows(tid) * num_vectors);
+
+        for (OffsetT row = row_begin; row < row_end; ++row)
+        {
+            OffsetT nz_begin    = u.row_offsets[row];
+            OffsetT nz_end      = u.row_offsets[row + 1];
+
+            // Stored half: Y[row] += A[row, row:] * X
+            SpmmRow(u.column_indices, u.values, nz_begin, nz_end, vector_x_row_major, num_vectors, num_vectors, row_total, 1);
+            ValueT* y = vector_y_out + row * y_row_stride;
+            for (int i = 0; i < num_vectors; ++i)
+                y[i * y_stride] += row_total[i];
+
+            // Mirrored half: Y[col] += A[row, col] * X[row] for col > row, split
+            // into the columns this thread owns and those that spill
+            const ValueT* x = vector_x_row_major + size_t(row) * num_vectors;
+            if ((nz_begin < nz_end) && (u.column_indices[nz_begin] == row))
+                ++nz_begin;
+
+            OffsetT nz_split = std::lower_bound(u.column_indices + nz_begin, u.column_indices + nz_end, row_end) - u.column_indices;
+
+            if (g_output_row_major)
+            {
+                SpmmScatterRow(u.column_indices, u.values, nz_begin, nz_split, x, num_vectors, vector_y_out, num_vectors, OffsetT(0));
+            }
+            else
+            {
+                for (OffsetT nz = nz_begin; nz < nz_split; ++nz)
+                {
+                    ValueT  val     = u.values[nz];
+                    ValueT* y_col   = vector_y_out + u.column_indices[nz];
+                    for (int i = 0; i < num_vectors; ++i)
+                        y_col[i * y_stride] += val * x[i];
+                }
+            }
+
+            SpmmScatterRow(u.column_indices, u.values, nz_split, nz_end, x, num_vectors, spill, num_vectors, row_end);
+        }
+    }
+
+    // Spill fix-up: each thread adds the parts of lower threads' spill blocks that overlap its rows
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        for (int source = 0; source < tid; ++source)
+        {
+            OffsetT source_end  = plan.row_begin[source + 1];
+            OffsetT begin       = std::max(plan.row_begin[tid], source_end);
+            OffsetT end         = std::min(plan.row_begin[tid + 1], plan.spill_end[source]);
+            for (OffsetT row = begin; row < end; ++row)
+            {
+                ValueT* y           = vector_y_out + row * y_row_stride;
+                ValueT* spill_row   = plan.spill[source] + size_t(row - source_end) * num_vectors;
+                for (int i = 0; i < num_vectors; ++i)
+                    y[i * y_stride] += spill_row[i];
+            }
+        }
+    }
+}
+
+
+/**
+ * Run OmpSymmetricCsrmm.  Extracting the triangle, planning the schedule and
+ * converting a column-major X are reported as setup time.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpSymmetricCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms,
+    int                             num_vectors,
+    ValueT*                         vector_x_row_major)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    CpuTimer timer;
+    timer.Start();
+    SymmetricSpmmPlan<ValueT, OffsetT> plan(a, g_omp_threads, num_vectors);
+    timer.Stop();
+    setup_ms = timer.ElapsedMillis();
+
+    // Column-major X is converted once, outside the timed loop
+    if (!g_input_row_major)
+        setup_ms += ConvertInputToRowMajor(g_omp_threads, vector_x_row_major, vector_x, a.num_cols, num_vectors);
+
+    if (!g_quiet)
+    {
+        long long spill_rows = 0;
+        for (int tid = 0; tid < g_omp_threads; ++tid)
+            spill_rows += plan.SpillRows(tid);
+        printf("\tUsing %d threads on %d procs, %d of %d nonzeros stored, %lld spill rows\n",
+            g_omp_threads, omp_get_num_procs(), plan.upper->num_nonzeros, a.num_nonzeros, spill_rows);
+    }
+
+    // Row-total scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
+    OmpSymmetricCsrmm(g_omp_threads, plan, vector_x_row_major, vector_y_out, num_vectors, scratch);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpSymmetricCsrmm(g_omp_threads, plan, vector_x_row_major, vector_y_out, num_vectors, scratch);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpSymmetricCsrmm(g_omp_threads, plan, vector_x_row_major, vector_y_out, num_vectors, scratch);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    return elapsed_ms / timing_iterations;
+}
+
+
+//---------------------------------------------------------------------
+// CPU transposed SpMM
+//---------------------------------------------------------------------
+
+/**
+ * Thread schedule and partial-output storage for Y = A^T X straight from A's
+ * CSR.  Threads split A's merge path as in OmpMergeCsrmm; row r of A then
+ * scatters a_rc * X(r, :) into Y row c, so thread tid reaches Y rows
+ * [col_begin, col_end).  The longest run of those rows that no other thread
+ * reaches, [exclusive_begin, exclusive_end), is updated in Y directly (when
+ * Y is row-major); the rest, usually just the ends of the range, go to a
+ * private row-major partial block of head rows [col_begin, exclusive_begin)
+ * followed by tail rows [exclusive_end, col_end), merged afterwards.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+struct TransposeSpmmPlan
+{
+    int                             num_threads;
+    int                             num_vectors;
+    std::vector<int2>               thread_coord;       // [num_threads + 1] merge path coordinates over A
+    std::vector<OffsetT>            col_begin;          // [num_threads] first Y row each thread reaches
+    std::vector<OffsetT>            col_end;            // [num_threads] one past the last
+    std::vector<OffsetT>            exclusive_begin;    // [num_threads] Y rows reached by this thread only
+    std::vector<OffsetT>            exclusive_end;
+    std::vector<ValueT*>            partial;            // [num_threads] head and tail blocks
+
+
+    TransposeSpmmPlan(
+        CsrMatrix<ValueT, OffsetT>&     a,
+        int                             num_threads,
+        int                             num_vectors,
+        bool                            y_row_major)
+    :
+        num_threads(num_threads),
+        num_vectors(num_vectors),
+        thread_coord(num_threads + 1),
+        col_begin(num_threads),
+        col_end(num_threads),
+        exclusive_begin(num_threads),
+        exclusive_end(num_threads),
+        partial(num_threads)
+    {
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+        OffsetT num_merge_items     = a.num_rows + a.num_nonzeros;
+        OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;
+
+        for (int tid = 0; tid <= num_threads; ++tid)
+            MergePathSearch(std::min(items_per_thread * tid, num_merge_items), a.row_offsets + 1, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord[tid]);
+
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (int tid = 0; tid < num_threads; ++tid)
+        {
+            OffsetT lo = a.num_cols;
+            OffsetT hi = 0;
+            for (OffsetT nz = thread_coord[tid].y; nz < thread_coord[tid + 1].y; ++nz)
+            {
+                lo = std::min(lo, a.column_indices[nz]);
+                hi = std::max(hi, a.column_indices[nz] + 1);
+            }
+            col_begin[tid]  = std::min(lo, hi);
+            col_end[tid]    = hi;
+        }
+
+        // Cover count (and, where it is one, the covering thread) of each elementary segment between range endpoints
+        std::vector<OffsetT> points;
+        for (int tid = 0; tid < num_threads; ++tid)
+        {
+            points.push_back(col_begin[tid]);
+            points.push_back(col_end[tid]);
+        }
+        std::sort(points.begin(), points.end());
+        points.erase(std::unique(points.begin(), points.end()), points.end());
+
+        std::vector<int>        cover(points.size(), 0);
+        std::vector<long long>  cover_tid(points.size(), 0);
+        for (int tid = 0; tid < num_threads; ++tid)
+        {
+            if (col_begin[tid] == col_end[tid])
+                continue;
+            size_t first    = std::lower_bound(points.begin(), points.end(), col_begin[tid]) - points.begin();
+            size_t last     = std::lower_bound(points.begin(), points.end(), col_end[tid]) - points.begin();
+            for (size_t i = first; i < last; ++i)
+            {
+                cover[i]++;
+                cover_tid[i] += tid;
+            }
+        }
+
+        for (int tid = 0; tid < num_threads; ++tid)
+        {
+            exclusive_begin[tid] = exclusive_end[tid] = col_begin[tid];
+            if (!y_row_major)
+                continue;
+
+            // Longest run of consecutive segments covered by this thread alone
+            for (size_t i = 0; i + 1 < points.size(); )
+            {
+                size_t j = i;
+                while ((j + 1 < points.size()) && (cover[j] == 1) && (cover_tid[j] == tid))
+                    ++j;
+                if ((j > i) && (points[j] - points[i] > exclusive_end[tid] - exclusive_begin[tid]))
+                {
+                    exclusive_begin[tid]    = points[i];
+                    exclusive_end[tid]      = points[j];
+                }
+                i = j + 1;
+            }
+        }
+
+        for (int tid = 0; tid < num_threads; ++tid)
+            partial[tid] = (ValueT*) mkl_malloc(sizeof(ValueT) * std::max(size_t(1), size_t(PartialRows(tid)) * num_vectors), 4096);
+    }
+
+
+    ~TransposeSpmmPlan()
+    {
+        for (int tid = 0; tid < num_threads; ++tid)
+            mkl_free(partial[tid]);
+    }
+
+
+    OffsetT HeadRows(int tid)
+    {
+        return exclusive_begin[tid] - col_begin[tid];
+    }
+
+
+    OffsetT PartialRows(int tid)
+    {
+        return (col_end[tid] - col_begin[tid]) - (exclusive_end[tid] - exclusive_begin[tid]);
+    }
+
+
+    // Bytes of partial-output storage across all threads
+    size_t PartialBytes()
+    {
+        size_t rows = 0;
+        for (int tid = 0; tid < num_threads; ++tid)
+            rows += PartialRows(tid);
+        return rows * num_vectors * sizeof(ValueT);
+    }
+};
+
+
+/**
+ * Scatter nonzeros [nz_begin, nz_end) of one row of A (columns sorted) for
+ * OmpMergeTransposeCsrmm: columns before the thread's exclusive rows go to
+ * the head block, columns in them straight to Y, and columns after them to
+ * the tail block
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+inline void TransposeScatterRow(
+    TransposeSpmmPlan<ValueT, OffsetT>&     plan,
+    int                                     tid,
+    CsrMatrix<ValueT, OffsetT>&             a,
+    OffsetT                                 nz_begin,
+    OffsetT                                 nz_end,
+    const ValueT*                           x,
+    ValueT*                                 vector_y_out,
+    int                                     num_vectors)
+{
+    if (nz_begin == nz_end)
+        return;
+
+    // Common case: the whole row lands in the exclusive rows
+    if ((a.column_indices[nz_begin] >= plan.exclusive_begin[tid]) && (a.column_indices[nz_end - 1] < plan.exclusive_end[tid]))
+    {
+        SpmmScatterRow(a.column_indices, a.values, nz_begin, nz_end, x, num_vectors, vector_y_out, num_vectors, OffsetT(0));
+        return;
+    }
+
+    OffsetT nz_exclusive_begin  = OffsetT(std::lower_bound(a.column_indices + nz_begin, a.column_indices + nz_end, plan.exclusive_begin[tid]) - a.column_indices);
+    OffsetT nz_exclusive_end    = OffsetT(std::lower_bound(a.column_indices + nz_exclusive_begin, a.column_indices + nz_end, plan.exclusive_end[tid]) - a.column_indices);
+
+    SpmmScatterRow(a.column_indices, a.values, nz_begin, nz_exclusive_begin, x, num_vectors, plan.partial[tid], num_vectors, plan.col_begin[tid]);
+    SpmmScatterRow(a.column_indices, a.values, nz_exclusive_begin, nz_exclusive_end, x, num_vectors, vector_y_out, num_vectors, OffsetT(0));
+    SpmmScatterRow(a.column_indices, a.values, nz_exclusive_end, nz_end, x, num_vectors, plan.partial[tid] + size_t(plan.HeadRows(tid)) * num_vectors, num_vectors, plan.exclusive_end[tid]);
+}
+
+
+/**
+ * OpenMP CPU merge-based transposed SpMM, Y = A^T X, without forming A^T.
+ * Each thread zeroes its exclusive Y rows and its partial block, then
+ * scatters its merge path segment of A (rows split across threads need no
+ * carry-out: every nonzero is scattered by the thread that owns it).  A
+ * second pass splits Y's rows evenly; each thread zeroes the rows in its
+ * slice that no thread owns exclusively and adds in, in thread order, every
+ * partial block overlapping them.  X is row-major (num_rows x num_vectors);
+ * Y is num_cols x num_vectors in the layout selected by g_output_row_major,
+ * which must match the plan's.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMergeTransposeCsrmm(
+    TransposeSpmmPlan<ValueT, OffsetT>&     plan,
+    CsrMatrix<ValueT, OffsetT>&             a,
+    ValueT*     __restrict                  vector_x_row_major,
+    ValueT*     __restrict                  vector_y_out,
+    int                                     num_vectors)
+{
+    int         num_threads     = plan.num_threads;
+    OffsetT*    row_end_offsets = a.row_offsets + 1;
+    int         y_stride        = g_output_row_major ? 1 : a.num_cols;
+    int         y_row_stride    = g_output_row_major ? num_vectors : 1;
+
+    // Scatter into exclusive Y rows and private partial blocks
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; ++tid)
+    {
+        memset(plan.partial[tid], 0, sizeof(ValueT) * plan.PartialRows(tid) * num_vectors);
+        memset(vector_y_out + size_t(plan.exclusive_begin[tid]) * num_vectors, 0, sizeof(ValueT) * (plan.exclusive_end[tid] - plan.exclusive_begin[tid]) * num_vectors);
+
+        int2 thread_coord       = plan.thread_coord[tid];
+        int2 thread_coord_end   = plan.thread_coord[tid + 1];
+
+        // Whole rows, then the partial portion of the thread's last row
+        for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+        {
+            TransposeScatterRow(plan, tid, a, thread_coord.y, row_end_offsets[thread_coord.x], vector_x_row_major + size_t(thread_coord.x) * num_vectors, vector_y_out, num_vectors);
+            thread_coord.y = row_end_offsets[thread_coord.x];
+        }
+        if (thread_coord.y < thread_coord_end.y)
+            TransposeScatterRow(plan, tid, a, thread_coord.y, thread_coord_end.y, vector_x_row_major + size_t(thread_coord.x) * num_vectors, vector_y_out, num_vectors);
+    }
+
+    // Merge the partial blocks over even slices of Y
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; ++tid)
+    {
+        OffsetT row_begin   = OffsetT((long long) a.num_cols * tid / num_threads);
+        OffsetT row_end     = OffsetT((long long) a.num_cols * (tid + 1) / num_threads);
+
+        for (OffsetT row = row_begin; row < row_end; ++row)
+        {
+            bool exclusive = false;
+            for (int source = 0; (source < num_threads) && !exclusive; ++source)
+                exclusive = (row >= plan.exclusive_begin[source]) && (row < plan.exclusive_end[source]);
+            if (exclusive)
+                continue;
+
+            ValueT* y = vector_y_out + size_t(row) * y_row_stride;
+            for (int k = 0; k < num_vectors; ++k)
+                y[k * y_stride] = 0.0;
+        }
+
+        for (int source = 0; source < num_threads; ++source)
+        {
+            // Head rows, then tail rows
+            for (int piece = 0; piece < 2; ++piece)
+            {
+                OffsetT piece_begin     = piece ? plan.exclusive_end[source] : plan.col_begin[source];
+                OffsetT piece_end       = piece ? plan.col_end[source] : plan.exclusive_begin[source];
+                ValueT* block           = plan.partial[source] + (piece ? size_t(plan.HeadRows(source)) * num_vectors : 0);
+                OffsetT overlap_begin   = std::max(row_begin, piece_begin);
+                OffsetT overlap_end     = std::min(row_end, piece_end);
+                for (OffsetT row = overlap_begin; row < overlap_end; ++row)
+                {
+                    ValueT* y       = vector_y_out + size_t(row) * y_row_stride;
+                    ValueT* b_row   = block + size_t(row - piece_begin) * num_vectors;
+                    for (int k = 0; k < num_vectors; ++k)
+                        y[k * y_stride] += b_row[k];
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * Run OmpMergeTransposeCsrmm against building A^T explicitly and running
+ * OmpMergeCsrmm on it (explicit_setup_ms, explicit_ms), reporting the extra
+ * memory each needs.  X (num_rows x num_vectors) and Y are allocated here
+ * since A may not be square.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpMergeTransposeCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    int                             timing_iterations,
+    float                           &setup_ms,
+    float                           &explicit_setup_ms,
+    float                           &explicit_ms,
+    int                             num_vectors)
+{
+    typedef typename CooMatrix<ValueT, OffsetT>::CooTuple CooTuple;
+
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    size_t  x_items             = size_t(a.num_rows) * num_vectors;
+    size_t  y_items             = size_t(a.num_cols) * num_vectors;
+    ValueT* vector_x            = (ValueT*) mkl_malloc(sizeof(ValueT) * x_items, 4096);
+    ValueT* vector_x_row_major  = (ValueT*) mkl_malloc(sizeof(ValueT) * x_items, 4096);
+    ValueT* vector_y_out        = (ValueT*) mkl_malloc(sizeof(ValueT) * y_items, 4096);
+    ValueT* reference           = (ValueT*) mkl_malloc(sizeof(ValueT) * y_items, 4096);
+
+    for (int row = 0; row < a.num_rows; ++row)
+    {
+        for (int k = 0; k < num_vectors; ++k)
+        {
+            size_t i = g_input_row_major ? size_t(row) * num_vectors + k : size_t(k) * a.num_rows + row;
+            vector_x[i] = SpmmInputValue<ValueT>(row, k);
+        }
+    }
+
+    // Explicit transpose (COO tuples, then a sorted CSR copy of A^T)
+    CpuTimer timer;
+    timer.Start();
+    CooMatrix<ValueT, OffsetT> coo_transpose;
+    coo_transpose.InitCsrTranspose(a);
+    CsrMatrix<ValueT, OffsetT> a_transpose(coo_transpose);
+    coo_transpose.Clear();
+    timer.Stop();
+    explicit_setup_ms = timer.ElapsedMillis();
+
+    // Direct plan, plus converting column-major X
+    timer.Start();
+    TransposeSpmmPlan<ValueT, OffsetT> plan(a, g_omp_threads, num_vectors, g_output_row_major);
+    timer.Stop();
+    setup_ms = timer.ElapsedMillis();
+    if (g_input_row_major)
+        memcpy(vector_x_row_major, vector_x, sizeof(ValueT) * x_items);
+    else
+        setup_ms += ConvertInputToRowMajor(g_omp_threads, vector_x_row_major, vector_x, a.num_rows, num_vectors);
+
+    if (!g_quiet)
+    {
+        size_t csr_bytes = sizeof(OffsetT) * (a.num_cols + 1) + (sizeof(OffsetT) + sizeof(ValueT)) * size_t(a.num_nonzeros);
+        size_t coo_bytes = sizeof(CooTuple) * size_t(a.num_nonzeros);
+        printf("\tUsing %d threads on %d procs, extra memory: %.2f MB partial blocks vs %.2f MB explicit A^T (%.2f MB peak while building)\n",
+            g_omp_threads, omp_get_num_procs(),
+            plan.PartialBytes() / 1048576.0,
+            csr_bytes / 1048576.0,
+            (csr_bytes + coo_bytes) / 1048576.0);
+    }
+
+    // Carry-out scratch for the explicit path
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+
+    // Warmup/correctness (reference from the explicit transpose)
+    memset(vector_y_out, -1, sizeof(ValueT) * y_items);
+    OmpMergeTransposeCsrmm(plan, a, vector_x_row_major, vector_y_out, num_vectors);
+    if (!g_quiet)
+    {
+        // Check answer
+        SpmmGold(g_omp_threads, a_transpose, vector_x, reference, num_vectors);
+        int compare = CompareSpmmResults(g_omp_threads, a_transpose, vector_x, reference, vector_y_out, num_vectors) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+
+    // Explicit timing
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a_transpose, a_transpose.row_offsets + 1, a_transpose.column_indices, a_transpose.values, vector_x, reference, num_vectors, scratch);
+    }
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmm(g_omp_threads, a_transpose, a_transpose.row_offsets + 1, a_transpose.column_indices, a_transpose.values, vector_x, reference, num_vectors, scratch);
+    }
+    timer.Stop();
+    explicit_ms = timer.ElapsedMillis() / timing_iterations;
+
+    // Direct timing
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeTransposeCsrmm(plan, a, vector_x_row_major, vector_y_out, num_vectors);
+    }
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeTransposeCsrmm(plan, a, vector_x_row_major, vector_y_out, num_vectors);
+    }
+    timer.Stop();
+
+    mkl_free(vector_x);
+    mkl_free(vector_x_row_major);
+    mkl_free(vector_y_out);
+    mkl_free(reference);
+
+    return timer.ElapsedMillis() / timing_iterations;
+}
+
+
+//---------------------------------------------------------------------
+// CPU adaptive sparse tiled SpMM
+//---------------------------------------------------------------------
+
+/**
+ * Epilogue that adds a row's dense-tile contribution to the remainder's
+ * output row while that row is still in cache.  The first time a thread
+ * reaches a row of a new panel it stages the X rows of the panel's dense
+ * columns contiguously in its stage buffer (max_panel_columns + 1 rows of
+ * num_vectors: the staged rows plus one accumulator row), so every tile
+ * nonzero of the panel reads X from one compact block, whatever X's layout.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+struct AdaptiveTileEpilogue
+{
+    enum
+    {
+        PANEL_PAD = 16,     // Spacing of per-thread staged-panel ids (avoids false sharing)
+    };
+
+    AdaptiveTiledCsrMatrix<ValueT, OffsetT>&    tiled;
+    ValueT*                                     vector_x;
+    ValueT*                                     stage;
+    OffsetT*                                    staged_panel;
+    size_t                                      stage_items;
+
+    AdaptiveTileEpilogue(
+        AdaptiveTiledCsrMatrix<ValueT, OffsetT>&    tiled,
+        ValueT*                                     vector_x,
+        ValueT*                                     stage,
+        OffsetT*                                    staged_panel,
+        int                                         num_threads,
+        int                                         num_vectors)
+    :
+        tiled(tiled),
+        vector_x(vector_x),
+        stage(stage),
+        staged_panel(staged_panel),
+        stage_items(size_t(tiled.max_panel_columns + 1) * num_vectors)
+    {
+        for (int tid = 0; tid < num_threads; ++tid)
+            staged_panel[tid * PANEL_PAD] = -1;
+    }
+
+    void operator()(OffsetT row, ValueT* y, int y_stride, int num_vectors) const
+    {
+        if (tiled.tile_row_offsets[row] == tiled.tile_row_offsets[row + 1])
+            return;
+
+        int     tid     = omp_get_thread_num();
+        OffsetT panel   = row / tiled.panel_rows;
+        ValueT* x_stage = stage + tid * stage_items;
+        ValueT* y_tile  = x_stage + size_t(tiled.max_panel_columns) * num_vectors;
+
+        // Stage the X rows of the panel's dense columns
+        if (staged_panel[tid * PANEL_PAD] != panel)
+        {
+            OffsetT* columns = tiled.dense_columns + tiled.panel_column_offsets[panel];
+            for (OffsetT j = 0; j < tiled.PanelColumns(panel); ++j)
+            {
+                if (g_input_row_major)
+                {
+                    memcpy(x_stage + size_t(j) * num_vectors, vector_x + size_t(columns[j]) * num_vectors, sizeof(ValueT) * num_vectors);
+                }
+                else
+                {
+                    for (int k = 0; k < num_vectors; ++k)
+                        x_stage[size_t(j) * num_vectors + k] = vector_x[size_t(k) * tiled.num_cols + columns[j]];
+                }
+            }
+            staged_panel[tid * PANEL_PAD] = panel;
+        }
+
+        SpmmRow(tiled.tile_column_indices, tiled.tile_values, tiled.tile_row_offsets[row], tiled.tile_row_offsets[row + 1], x_stage, num_vectors, num_vectors, y_tile, 1);
+        for (int k = 0; k < num_vectors; ++k)
+            y[k * y_stride] += y_tile[k];
+    }
+};
+
+
+/**
+ * OpenMP CPU SpMM over an adaptive sparse tiled matrix: OmpMergeCsrmm
+ * multiplies the remainder, and an AdaptiveTileEpilogue adds each finished
+ * row's dense-tile contribution.  Threads are balanced on the remainder's
+ * merge path only.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpAdaptiveTiledCsrmm(
+    int                                         num_threads,
+    AdaptiveTiledCsrMatrix<ValueT, OffsetT>&    tiled,
+    ValueT*     __restrict                      vector_x,
+    ValueT*     __restrict                      vector_y_out,
+    int                                         num_vectors,
+    SpmmScratch<ValueT, OffsetT>&               scratch,        ///< Per-thread carry-outs for the remainder
+    ValueT*     __restrict                      stage,          ///< Per-thread staged X rows
+    OffsetT*    __restrict                      staged_panel)   ///< Per-thread staged-panel ids
+{
+    CsrMatrix<ValueT, OffsetT>              &remainder = *tiled.remainder;
+    AdaptiveTileEpilogue<ValueT, OffsetT>   tile_epilogue(tiled, vector_x, stage, staged_panel, num_threads, num_vectors);
+
+    OmpMergeCsrmm(num_threads, remainder, remainder.row_offsets + 1, remainder.column_indices, remainder.values, vector_x, vector_y_out, num_vectors, scratch, PlusTimes<ValueT>(), tile_epilogue);
+}
+
+
+/**
+ * Run OmpAdaptiveTiledCsrmm.  Building the tiled matrix is reported as setup
+ * time.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpAdaptiveTiledCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms,
+    int                             num_vectors,
+    int                             panel_rows,
+    int                             min_reuse)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    CpuTimer timer;
+    timer.Start();
+    AdaptiveTiledCsrMatrix<ValueT, OffsetT> tiled(a, panel_rows, min_reuse, g_omp_threads);
+    timer.Stop();
+    setup_ms = timer.ElapsedMillis();
+
+    if (!g_quiet)
+    {
+        printf("\tUsing %d threads on %d procs, %d panels of %d rows, reuse >= %d\n",
+            g_omp_threads, omp_get_num_procs(), tiled.num_panels, panel_rows, min_reuse);
+        printf("\t%d of %d nonzeros (%.1f%%) in dense tiles over %d panel columns (%.2f nonzeros each, at most %d per panel)\n",
+            tiled.TileNonzeros(), a.num_nonzeros, 100.0 * tiled.TileNonzeros() / std::max(a.num_nonzeros, 1),
+            tiled.panel_column_offsets[tiled.num_panels],
+            double(tiled.TileNonzeros()) / std::max(tiled.panel_column_offsets[tiled.num_panels], 1),
+            tiled.max_panel_columns);
+    }
+
+    // Carry-out and staging scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+    size_t                  stage_items = size_t(tiled.max_panel_columns + 1) * num_vectors;
+    ValueT*                 stage       = (ValueT*) mkl_malloc(sizeof(ValueT) * stage_items * g_omp_threads, 4096);
+    std::vector<OffsetT>    staged_panel(g_omp_threads * AdaptiveTileEpilogue<ValueT, OffsetT>::PANEL_PAD);
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
+    OmpAdaptiveTiledCsrmm(g_omp_threads, tiled, vector_x, vector_y_out, num_vectors, scratch, stage, &staged_panel[0]);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpAdaptiveTiledCsrmm(g_omp_threads, tiled, vector_x, vector_y_out, num_vectors, scratch, stage, &staged_panel[0]);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpAdaptiveTiledCsrmm(g_omp_threads, tiled, vector_x, vector_y_out, num_vectors, scratch, stage, &staged_panel[0]);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    mkl_free(stage);
+
+    return elapsed_ms / timing_iterations;
+}
+
+
+//---------------------------------------------------------------------
+// CPU fused GNN layer SpMM
+//---------------------------------------------------------------------
+
+/**
+ * Association order for a GNN layer Y = A X W (X num_cols x k_in, W k_in x
+ * k_out): aggregating first, (A X) W, costs nnz * k_in + num_rows * k_in *
+ * k_out multiply-adds and transforming first, A (X W), num_cols * k_in *
+ * k_out + nnz * k_out.  Returns true if aggregating first is cheaper.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+bool GnnLayerAggregateFirst(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    int                             k_in,
+    int                             k_out)
+{
+    double aggregate_first = double(a.num_nonzeros) * k_in + double(a.num_rows) * k_in * k_out;
+    double transform_first = double(a.num_cols) * k_in * k_out + double(a.num_nonzeros) * k_out;
+    return aggregate_first <= transform_first;
+}
+
+
+/**
+ * Rows of A X per GNN layer block: a thread's block of k_in-wide rows and W
+ * should share half of L2 (at least 16 rows, at most 256)
+ */
+template <typename ValueT>
+int GnnLayerBlockRows(
+    int     k_in,
+    int     k_out)
+{
+    size_t w_bytes  = sizeof(ValueT) * k_in * k_out;
+    size_t budget   = (g_l2_bytes / 2 > w_bytes) ? g_l2_bytes / 2 - w_bytes : 0;
+    return std::min(256, std::max(16, int(budget / (sizeof(ValueT) * k_in))));
+}
+
+
+/**
+ * Scratch for the GNN layer kernels, allocated once for all calls.  Each
+ * thread gets a row-major block of block_rows rows of A X plus one head row
+ * (its first row, which may still receive carry-outs); aggregating last needs
+ * the num_cols x k_out product X W instead.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+struct GnnLayerScratch
+{
+    enum
+    {
+        CACHE_LINE_BYTES    = 64,
+        HEAD_PAD            = 16,     // Spacing of per-thread head-row ids (avoids false sharing)
+    };
+
+    int                             block_rows;
+    int                             k_in;
+    size_t                          thread_items;   // Block and head row, padded to a cache line
+    ValueT*                         blocks;
+    std::vector<OffsetT>            head_rows;
+    ValueT*                         xw;
+    SpmmScratch<ValueT, OffsetT>    carry;
+
+    GnnLayerScratch(
+        int         num_threads,
+        int         block_rows,
+        int         k_in,
+        int         k_out,
+        OffsetT     num_cols)
+    :
+        block_rows(block_rows),
+        k_in(k_in),
+        thread_items((sizeof(ValueT) * (block_rows + 1) * k_in + CACHE_LINE_BYTES - 1) / CACHE_LINE_BYTES * CACHE_LINE_BYTES / sizeof(ValueT)),
+        head_rows(num_threads * HEAD_PAD, -1),
+        carry(num_threads, k_in)
+    {
+        blocks  = (ValueT*) mkl_malloc(sizeof(ValueT) * thread_items * num_threads, 4096);
+        xw      = (ValueT*) mkl_malloc(sizeof(ValueT) * size_t(num_cols) * k_out, 4096);
+    }
+
+    ~GnnLayerScratch()
+    {
+        mkl_free(blocks);
+        mkl_free(xw);
+    }
+
+    // Thread tid's block of A X rows
+    ValueT* Block(int tid)
+    {
+        return blocks + thread_items * tid;
+    }
+
+    // Thread tid's head row
+    ValueT* Head(int tid)
+    {
+        return Block(tid) + size_t(block_rows) * k_in;
+    }
+
+    // The row thread tid's head row belongs to (-1 if none)
+    OffsetT& HeadRow(int tid)
+    {
+        return head_rows[tid * HEAD_PAD];
+    }
+};
+
+
+/**
+ * Y rows [row, row + num_rows) = block W, for a row-major block of A X rows
+ * and a row-major W, with Y in the layout selected by g_output_row_major
+ */
+template <typename ValueT>
+void GnnLayerBlockGemm(
+    const ValueT*   block,
+    int             num_rows,
+    const ValueT*   w,
+    int             k_in,
+    int             k_out,
+    ValueT*         y,          ///< Y's first row of the block
+    int             ldy)
+{
+    if (g_output_row_major)
+        DenseGemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, num_rows, k_out, k_in, block, k_in, w, k_out, y, ldy);
+    else
+        DenseGemm(CblasColMajor, CblasTrans, CblasTrans, num_rows, k_out, k_in, block, k_in, w, k_out, y, ldy);
+}
+
+
+/**
+ * OpenMP CPU merge-based GNN layer Y = (A X) W, aggregating first, without
+ * materializing A X.  Threads split A's merge path as in OmpMergeCsrmm and
+ * accumulate their finished rows of A X in a cache-sized row block; each full
+ * block is multiplied by W straight into Y with a small GEMM.  A thread's
+ * first row is held back in its head row, the partial last row goes to the
+ * carry-out, and after the fix-up the head rows are multiplied out one by
+ * one.  X is k_in wide in the layout selected by g_input_row_major, W is
+ * row-major k_in x k_out, and Y is k_out wide.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMergeAggregateFirstCsrmm(
+    int                                 num_threads,
+    CsrMatrix<ValueT, OffsetT>&         a,
+    OffsetT*    __restrict              row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict              column_indices,
+    ValueT*     __restrict              values,
+    ValueT*     __restrict              vector_x,
+    ValueT*     __restrict              w,
+    ValueT*     __restrict              vector_y_out,
+    int                                 k_in,
+    int                                 k_out,
+    GnnLayerScratch<ValueT, OffsetT>&   scratch)
+{
+    int     ldx             = g_input_row_major ? k_in : a.num_cols;
+    int     ldy             = g_output_row_major ? k_out : a.num_rows;
+    size_t  y_row_stride    = g_output_row_major ? ldy : 1;
+    int     block_rows      = scratch.block_rows;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        // Merge list B (NZ indices)
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+
+        OffsetT num_merge_items     = a.num_rows + a.num_nonzeros;                          // Merge path total length
+        OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;    // Merge items per thread
+
+        // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
+        int2    thread_coord;
+        int2    thread_coord_end;
+        int     start_diagonal      = std::min(items_per_thread * tid, num_merge_items);
+        int     end_diagonal        = std::min(start_diagonal + items_per_thread, num_merge_items);
+
+        MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord);
+        MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord_end);
+
+        ValueT* block       = scratch.Block(tid);
+        OffsetT first_row   = (tid > 0) ? thread_coord.x : -1;
+        OffsetT block_row   = thread_coord.x;       // Row of A X in the block's first slot
+        int     block_items = 0;                    // Rows in the block
+
+        scratch.HeadRow(tid) = -1;
+
+        // Consume whole rows into the head row or the block, multiplying out full blocks
+        for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+        {
+            if (thread_coord.x == first_row)
+            {
+                SpmmRow(g_input_row_major, column_indices, values, thread_coord.y, row_end_offsets[thread_coord.x], vector_x, ldx, k_in, scratch.Head(tid), 1);
+                scratch.HeadRow(tid) = first_row;
+                block_row++;
+            }
+            else
+            {
+                SpmmRow(g_input_row_major, column_indices, values, thread_coord.y, row_end_offsets[thread_coord.x], vector_x, ldx, k_in, block + size_t(block_items) * k_in, 1);
+                if (++block_items == block_rows)
+                {
+                    GnnLayerBlockGemm(block, block_items, w, k_in, k_out, vector_y_out + block_row * y_row_stride, ldy);
+                    block_row   += block_items;
+                    block_items = 0;
+                }
+            }
+            thread_coord.y = row_end_offsets[thread_coord.x];
+        }
+
+        if (block_items > 0)
+            GnnLayerBlockGemm(block, block_items, w, k_in, k_out, vector_y_out + block_row * y_row_stride, ldy);
+
+        // Consume partial portion of thread's last row
+        SpmmRow(g_input_row_major, column_indices, values, thread_coord.y, thread_coord_end.y, vector_x, ldx, k_in, scratch.carry.Carry(tid), 1);
+
+        // Save carry-outs
+        scratch.carry.CarryRow(tid) = thread_coord_end.x;
+    }
+
+    // Carry-out fix-up: into the head row of the first later thread that finished the row
+    for (int tid = 0; tid < num_threads - 1; ++tid)
+    {
+        OffsetT row = scratch.carry.CarryRow(tid);
+        if (row < a.num_rows)
+        {
+            int owner = tid + 1;
+            while (scratch.HeadRow(owner) != row)
+                ++owner;
+
+            ValueT* head    = scratch.Head(owner);
+            ValueT* carry   = scratch.carry.Carry(tid);
+            for (int i = 0; i < k_in; ++i)
+                head[i] += carry[i];
+        }
+    }
+
+    // Head rows
+    for (int tid = 1; tid < num_threads; ++tid)
+    {
+        OffsetT row = scratch.HeadRow(tid);
+        if (row >= 0)
+            GnnLayerBlockGemm(scratch.Head(tid), 1, w, k_in, k_out, vector_y_out + row * y_row_stride, ldy);
+    }
+}
+
+
+/**
+ * OpenMP CPU GNN layer Y = A (X W), transforming first: X W (num_cols x
+ * k_out, in X's layout) is one GEMM, followed by OmpMergeCsrmm on it
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMergeTransformFirstCsrmm(
+    int                                 num_threads,
+    CsrMatrix<ValueT, OffsetT>&         a,
+    ValueT*     __restrict              vector_x,
+    ValueT*     __restrict              w,
+    ValueT*     __restrict              vector_y_out,
+    int                                 k_in,
+    int                                 k_out,
+    GnnLayerScratch<ValueT, OffsetT>&   scratch)
+{
+    if (g_input_row_major)
+        DenseGemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, a.num_cols, k_out, k_in, vector_x, k_in, w, k_out, scratch.xw, k_out);
+    else
+        DenseGemm(CblasColMajor, CblasNoTrans, CblasTrans, a.num_cols, k_out, k_in, vector_x, a.num_cols, w, k_out, scratch.xw, a.num_cols);
+
+    OmpMergeCsrmm(num_threads, a, a.row_offsets + 1, a.column_indices, a.values, scratch.xw, vector_y_out, k_out, scratch.carry);
+}
+
+
+/**
+ * OpenMP CPU GNN layer Y = A X W in the cheaper association order (see
+ * GnnLayerAggregateFirst)
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMergeGnnLayerCsrmm(
+    int                                 num_threads,
+    CsrMatrix<ValueT, OffsetT>&         a,
+    ValueT*     __restrict              vector_x,
+    ValueT*     __restrict              w,
+    ValueT*     __restrict              vector_y_out,
+    int                                 k_in,
+    int                                 k_out,
+    GnnLayerScratch<ValueT, OffsetT>&   scratch)
+{
+    if (GnnLayerAggregateFirst(a, k_in, k_out))
+        OmpMergeAggregateFirstCsrmm(num_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, w, vector_y_out, k_in, k_out, scratch);
+    else
+        OmpMergeTransformFirstCsrmm(num_threads, a, vector_x, w, vector_y_out, k_in, k_out, scratch);
+}
+
+
+/**
+ * Compare a GNN layer result against A X W summed in fp64.  Besides the
+ * reordering CompareSpmmResults allows for, the two association orders round
+ * differently, so each output may be off by about 2 * (n + k_in) * eps times
+ * the sum of |a_ij * x_jl * w_lk| over its row.  Returns the number of
+ * mismatches, printing the first few if verbose.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+OffsetT CompareGnnLayerResults(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         w,
+    ValueT*                         vector_y_out,
+    int                             k_in,
+    int                             k_out,
+    bool                            verbose = true)
+{
+    const double    eps             = std::numeric_limits<ValueT>::epsilon();
+    const int       max_reported    = 8;
+
+    size_t x_row_stride = g_input_row_major ? k_in : 1;
+    size_t x_stride     = g_input_row_major ? 1 : a.num_cols;
+    size_t y_row_stride = g_output_row_major ? k_out : 1;
+    size_t y_stride     = g_output_row_major ? 1 : a.num_rows;
+
+    OffsetT errors = 0;
+
+    #pragma omp parallel num_threads(num_threads) reduction(+:errors)
+    {
+        std::vector<double> ax(k_in), ax_magnitude(k_in);
+
+        #pragma omp for schedule(static)
+        for (OffsetT row = 0; row < a.num_rows; ++row)
+        {
+            OffsetT row_length = a.row_offsets[row + 1] - a.row_offsets[row];
+            for (int l = 0; l < k_in; ++l)
+            {
+                ax[l]           = 0.0;
+                ax_magnitude[l] = 0.0;
+                for (OffsetT offset = a.row_offsets[row]; offset < a.row_offsets[row + 1]; ++offset)
+                {
+                    double product  = double(a.values[offset]) * double(vector_x[a.column_indices[offset] * x_row_stride + l * x_stride]);
+                    ax[l]           += product;
+                    ax_magnitude[l] += fabs(product);
+                }
+            }
+
+            for (int k = 0; k < k_out; ++k)
+            {
+                double expected     = 0.0;
+                double magnitude    = 0.0;
+                for (int l = 0; l < k_in; ++l)
+                {
+                    expected    += ax[l] * double(w[size_t(l) * k_out + k]);
+                    magnitude   += ax_magnitude[l] * fabs(double(w[size_t(l) * k_out + k]));
+                }
+
+                ValueT  computed    = vector_y_out[row * y_row_stride + k * y_stride];
+                double  tolerance   = 4.0 * (row_length + k_in + 1) * eps * magnitude;
+
+                // Written this way round so that NaN fails
+                if (!(fabs(double(computed) - expected) <= tolerance))
+                {
+                    if (verbose)
+                    {
+                        #pragma omp critical
+                        if (errors < max_reported)
+                            printf("\tINCORRECT: row %lld, column %d: %.10g != %.10g (tolerance %.3g)\n",
+                                (long long) row, k, double(computed), expected, tolerance);
+                    }
+                    errors++;
+                }
+            }
+        }
+    }
+
+    if (verbose && errors)
+        printf("\t%lld of %lld outputs incorrect\n", (long long) errors, (long long) a.num_rows * k_out);
+
+    return errors;
+}
+
+
+/**
+ * Run a GNN layer Y = A X W (X num_vectors wide, W num_vectors x k_out) in
+ * both association orders, reporting which one GnnLayerAggregateFirst picks.
+ * Returns the time of the chosen order; unfused_ms is the time of plain
+ * OmpMergeCsrmm into a materialized A X followed by one GEMM, and other_ms
+ * that of the order not chosen.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpMergeGnnLayerCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    int                             timing_iterations,
+    float                           &unfused_ms,
+    float                           &other_ms,
+    int                             num_vectors,
+    int                             k_out)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    int     k_in            = num_vectors;
+    int     block_rows      = GnnLayerBlockRows<ValueT>(k_in, k_out);
+    bool    aggregate_first = GnnLayerAggregateFirst(a, k_in, k_out);
+
+    if (!g_quiet)
+    {
+        printf("\tUsing %d threads on %d procs, %d -> %d features, %d-row blocks\n",
+            g_omp_threads, omp_get_num_procs(), k_in, k_out, block_rows);
+        printf("\t(AX)W %.3g Mflop, A(XW) %.3g Mflop: %s first\n",
+            2e-6 * (double(a.num_nonzeros) * k_in + double(a.num_rows) * k_in * k_out),
+            2e-6 * (double(a.num_cols) * k_in * k_out + double(a.num_nonzeros) * k_out),
+            aggregate_first ? "aggregating" : "transforming");
+    }
+
+    std::vector<ValueT> w(size_t(k_in) * k_out);
+    for (int l = 0; l < k_in; ++l)
+        for (int k = 0; k < k_out; ++k)
+            w[size_t(l) * k_out + k] = SpmmInputValue<ValueT>(l + 7919, k);
+
+    size_t  y_items     = size_t(a.num_rows) * k_out;
+    ValueT* vector_y_out = (ValueT*) mkl_malloc(sizeof(ValueT) * y_items, 4096);
+    ValueT* ax          = (ValueT*) mkl_malloc(sizeof(ValueT) * a.num_rows * k_in, 4096);
+
+    GnnLayerScratch<ValueT, OffsetT>    scratch(g_omp_threads, block_rows, k_in, k_out, a.num_cols);
+    SpmmScratch<ValueT, OffsetT>        unfused_scratch(g_omp_threads, k_in);
 
     // Warmup/correctness
-    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
-    OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, vector_x_row_major);
     if (!g_quiet)
     {
-        // Check answer
-        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
-        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+        memset(vector_y_out, -1, sizeof(ValueT) * y_items);
+        OmpMergeAggregateFirstCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, &w[0], vector_y_out, k_in, k_out, scratch);
+        int compare = CompareGnnLayerResults(g_omp_threads, a, vector_x, &w[0], vector_y_out, k_in, k_out) != 0;
+        printf("\t(AX)W fused: %s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+
+        memset(vector_y_out, -1, sizeof(ValueT) * y_items);
+        OmpMergeTransformFirstCsrmm(g_omp_threads, a, vector_x, &w[0], vector_y_out, k_in, k_out, scratch);
+        compare = CompareGnnLayerResults(g_omp_threads, a, vector_x, &w[0], vector_y_out, k_in, k_out) != 0;
+        printf("\tA(XW): %s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
     }
- 
-    // Re-populate caches, etc.
+
+    // Unfused: materialize A X, then one GEMM
+    int ldax = g_output_row_major ? k_in : a.num_rows;
+    int ldy  = g_output_row_major ? k_out : a.num_rows;
     for(int it = 0; it < timing_iterations; ++it)
     {
-        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, vector_x_row_major);
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, ax, k_in, unfused_scratch);
+        DenseGemm(g_output_row_major ? CblasRowMajor : CblasColMajor, CblasNoTrans, g_output_row_major ? CblasNoTrans : CblasTrans, a.num_rows, k_out, k_in, ax, ldax, &w[0], k_out, vector_y_out, ldy);
     }
 
-    // Timing
-    float elapsed_ms = 0.0;
     CpuTimer timer;
     timer.Start();
     for(int it = 0; it < timing_iterations; ++it)
     {
-        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, vector_x_row_major);
+        OmpMergeCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, ax, k_in, unfused_scratch);
+        DenseGemm(g_output_row_major ? CblasRowMajor : CblasColMajor, CblasNoTrans, g_output_row_major ? CblasNoTrans : CblasTrans, a.num_rows, k_out, k_in, ax, ldax, &w[0], k_out, vector_y_out, ldy);
     }
     timer.Stop();
-    elapsed_ms += timer.ElapsedMillis();
-
-    return elapsed_ms / timing_iterations;
-}
-
-template <
-    typename AIteratorT,
-    typename BIteratorT,
-    typename OffsetT,
-    typename CoordinateT>
-inline void RowPathSearch(
-    AIteratorT      a,                  ///< [in]List A
-    BIteratorT      b,                  ///< [in]List B
-    OffsetT         a_len,              ///< [in]Length of A
-    CoordinateT&    path_coordinate)    ///< [out] (x,y) coordinate where diagonal intersects the merge path
-{
-    OffsetT x_min = 0;
-    OffsetT x_max = a_len;
+    unfused_ms = timer.ElapsedMillis() / timing_iterations;
 
-    while (x_min < x_max)
+    // Both association orders
+    float order_ms[2];
+    for (int order = 0; order < 2; ++order)
     {
-        OffsetT x_pivot = (x_min + x_max) >> 1;
-        if (a[x_pivot] <= b[path_coordinate.y - 1])
-            x_min = x_pivot + 1;    // Contract range up A (down B)
-        else
-            x_max = x_pivot;        // Contract range down A (up B)
+        // Re-populate caches, etc.
+        for(int it = 0; it < timing_iterations; ++it)
+        {
+            if (order == 0)
+                OmpMergeAggregateFirstCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, &w[0], vector_y_out, k_in, k_out, scratch);
+            else
+                OmpMergeTransformFirstCsrmm(g_omp_threads, a, vector_x, &w[0], vector_y_out, k_in, k_out, scratch);
+        }
+
+        timer.Start();
+        for(int it = 0; it < timing_iterations; ++it)
+        {
+            if (order == 0)
+                OmpMergeAggregateFirstCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, &w[0], vector_y_out, k_in, k_out, scratch);
+            else
+                OmpMergeTransformFirstCsrmm(g_omp_threads, a, vector_x, &w[0], vector_y_out, k_in, k_out, scratch);
+        }
+        timer.Stop();
+        order_ms[order] = timer.ElapsedMillis() / timing_iterations;
     }
 
-    path_coordinate.x = std::min(x_min, a_len);
+    if (!g_quiet)
+        printf("\tunfused (AX)W %.4f ms, fused (AX)W %.4f ms, A(XW) %.4f ms\n", unfused_ms, order_ms[0], order_ms[1]);
+
+    mkl_free(vector_y_out);
+    mkl_free(ax);
+
+    other_ms = order_ms[aggregate_first ? 1 : 0];
+    return order_ms[aggregate_first ? 0 : 1];
 }
 
+
+//---------------------------------------------------------------------
+// CPU row-clustered SpMM
+//---------------------------------------------------------------------
+
 /**
- * OpenMP CPU row-based SpMM
+ * X-row reuse in A's row order: for every gather of an X row after its first,
+ * the number of distinct X rows gathered since the previous gather of the
+ * same row (its LRU stack distance, counted with a Fenwick tree over gather
+ * times holding a 1 at each X row's latest gather).  Reports the fraction of
+ * gathers that are first touches, the fraction of the rest within window
+ * distinct rows (the gathers an LRU cache of window X rows would hit) and the
+ * median distance.  The stream is A's whole row order; each thread sees its
+ * own contiguous piece of it.
  */
 template <
     typename ValueT,
     typename OffsetT>
-void OmpNonzeroSplitCsrmm(
-    int                             num_threads,
+void XRowReuse(
     CsrMatrix<ValueT, OffsetT>&     a,
-    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
-    OffsetT*    __restrict        column_indices,
-    ValueT*     __restrict        values,
-    ValueT*     __restrict        vector_x,
-    ValueT*     __restrict        vector_y_out,
-    int                           num_vectors,
-    ValueT*     __restrict        vector_x_row_major)
+    OffsetT                         window,
+    double                          &cold_fraction,
+    double                          &hit_fraction,
+    OffsetT                         &median_distance)
 {
-    // Temporary storage for inter-thread fix-up after load-balanced work
-    OffsetT     row_carry_out[256];     // The last row-id each worked on by each thread when it finished its path segment
-    ValueT*     value_carry_out[256];   // The running total within each thread when it finished its path segment
+    std::vector<OffsetT>    fenwick(a.num_nonzeros + 1, 0);
+    std::vector<OffsetT>    last_gather(a.num_cols, -1);
+    std::vector<OffsetT>    distances;
+    OffsetT                 hits = 0;
+    distances.reserve(a.num_nonzeros);
 
-    int num_cols = a.num_cols;
-    int num_rows = a.num_rows;
-    int xt_index = 0;
-
-    #pragma omp parallel for schedule(static) num_threads(num_threads)
-    for (int tid = 0; tid < num_threads; tid++)
+    for (OffsetT nz = 0; nz < a.num_nonzeros; ++nz)
     {
-        // Merge list B (NZ indices)
-        CountingInputIterator<OffsetT>  nonzero_indices(0);
-
-        OffsetT num_nonzeros     = a.num_nonzeros;                          
-        OffsetT items_per_thread    = (num_nonzeros + num_threads - 1) / num_threads;
-
-        // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
-        int2    thread_coord;
-        int2    thread_coord_end;
-        thread_coord.y            = std::min(items_per_thread * tid, num_nonzeros);
-        thread_coord_end.y        = std::min(thread_coord.y + items_per_thread, num_nonzeros);
-
-        RowPathSearch(row_end_offsets, nonzero_indices, a.num_rows, thread_coord);
-        RowPathSearch(row_end_offsets, nonzero_indices, a.num_rows, thread_coord_end);
-
-        // Consume whole rows
-        ValueT running_total[num_vectors] = {0.0};
-        ValueT val;
-        ValueT* tmp;
-        int ind;
-        for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
-        {
-            for (; thread_coord.y < row_end_offsets[thread_coord.x]; ++thread_coord.y)
-            {
-                val = values[thread_coord.y];
-                ind = column_indices[thread_coord.y]*num_vectors;
-                tmp = vector_x_row_major+ind;
-                for (int i=0; i<num_vectors; i++){
-                    running_total[i] += val * tmp[i];
-                }
-            }
-            
-            ind = thread_coord.x*num_vectors;
-            tmp = vector_y_out+ind;
-            for (int i=0; i<num_vectors; i++){
-                tmp[i] = running_total[i];
-                running_total[i] = 0.0;
-            }
-        }
-
-        // Consume partial portion of thread's last row
-        for (; thread_coord.y < thread_coord_end.y; ++thread_coord.y)
+        OffsetT col = a.column_indices[nz];
+        if (last_gather[col] >= 0)
         {
-            val = values[thread_coord.y];
-            ind = column_indices[thread_coord.y]*num_vectors;
-            tmp = vector_x_row_major+ind;
-            for (int i=0; i<num_vectors; i++){
-                running_total[i] += val * tmp[i];
-            }
+            // Latest gathers in (last_gather[col], nz)
+            OffsetT distance = 0;
+            for (OffsetT i = nz; i > 0; i -= i & -i)
+                distance += fenwick[i];
+            for (OffsetT i = last_gather[col] + 1; i > 0; i -= i & -i)
+                distance -= fenwick[i];
+
+            distances.push_back(distance);
+            if (distance < window)
+                hits++;
+
+            for (OffsetT i = last_gather[col] + 1; i <= a.num_nonzeros; i += i & -i)
+                fenwick[i]--;
         }
 
-        // Save carry-outs
-        row_carry_out[tid] = thread_coord_end.x;
-        value_carry_out[tid] = running_total;
+        for (OffsetT i = nz + 1; i <= a.num_nonzeros; i += i & -i)
+            fenwick[i]++;
+        last_gather[col] = nz;
     }
 
-    // Carry-out fix-up (rows spanning multiple threads)
-    int ind;
-    ValueT* tmp;
-    for (int tid = 0; tid < num_threads - 1; ++tid)
+    cold_fraction   = double(a.num_nonzeros - OffsetT(distances.size())) / std::max(a.num_nonzeros, OffsetT(1));
+    hit_fraction    = double(hits) / std::max(OffsetT(distances.size()), OffsetT(1));
+    median_distance = 0;
+    if (!distances.empty())
     {
-        if (row_carry_out[tid] < a.num_rows){
-            ind = row_carry_out[tid]*num_vectors;
-            tmp = vector_y_out+ind;
-            for (int i=0; i<num_vectors; i++){
-                tmp[i] += value_carry_out[tid][i];
-            }
-        }
+        std::nth_element(distances.begin(), distances.begin() + distances.size() / 2, distances.end());
+        median_distance = distances[distances.size() / 2];
     }
 }
 
+
+/**
+ * Run OmpMergeCsrmm on a copy of A whose rows are clustered by
+ * MinHashRowRelabel.  X is used as is; Y comes out in clustered row order and
+ * is gathered back afterwards (timed separately, like the permutes of the
+ * reordered SpMV).  Clustering and building the copy are reported as setup
+ * time.  Clusters are capped at as many nonzeros as there are X rows that fit
+ * in L2, and the X-row reuse of both row orders is reported against the same
+ * window.
+ */
 template <
     typename ValueT,
     typename OffsetT>
-float TestOmpNonzeroSplitCsrmm(
+float TestOmpClusteredCsrmm(
     CsrMatrix<ValueT, OffsetT>&     a,
     ValueT*                         vector_x,
     ValueT*                         reference_vector_y_out,
@@ -796,55 +3916,88 @@ float TestOmpNonzeroSplitCsrmm(
     int                             timing_iterations,
     float                           &setup_ms,
     int                             num_vectors,
-    ValueT*                         vector_x_row_major)
+    int                             num_bands)
 {
-    setup_ms = 0.0;
-
     if (g_omp_threads == -1)
         g_omp_threads = omp_get_num_procs();
-    int num_threads = g_omp_threads;
+
+    // Cluster
+    CpuTimer timer;
+    timer.Start();
+
+    OffsetT window = OffsetT(std::max(size_t(1), g_l2_bytes / (sizeof(ValueT) * num_vectors)));
+
+    OffsetT* row_relabel_indices = new OffsetT[a.num_rows];
+    MinHashRowRelabel(a, row_relabel_indices, num_bands, window, g_omp_threads);
+
+    CooMatrix<ValueT, OffsetT> clustered_coo;
+    clustered_coo.InitCsrRowRelabel(a, row_relabel_indices);
+    CsrMatrix<ValueT, OffsetT> clustered_matrix(clustered_coo);
+    clustered_coo.Clear();
+
+    timer.Stop();
+    setup_ms = timer.ElapsedMillis();
 
     if (!g_quiet)
-        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+    {
+        double  cold_fraction, hit_fraction;
+        OffsetT median_distance;
+
+        printf("\tUsing %d threads on %d procs, %d MinHash bands, clusters of up to %d nonzeros\n", g_omp_threads, omp_get_num_procs(), num_bands, (int) window);
+        XRowReuse(a, window, cold_fraction, hit_fraction, median_distance);
+        printf("\tX-row reuse, original:  %.1f%% first touches, %.1f%% of reuses within %d rows (L2), median distance %d\n",
+            100.0 * cold_fraction, 100.0 * hit_fraction, (int) window, (int) median_distance);
+        XRowReuse(clustered_matrix, window, cold_fraction, hit_fraction, median_distance);
+        printf("\tX-row reuse, clustered: %.1f%% first touches, %.1f%% of reuses within %d rows (L2), median distance %d\n",
+            100.0 * cold_fraction, 100.0 * hit_fraction, (int) window, (int) median_distance);
+    }
+
+    // Carry-out scratch, allocated once for all calls
+    SpmmScratch<ValueT, OffsetT> scratch(g_omp_threads, num_vectors);
+    ValueT* clustered_vector_y_out = (ValueT*) mkl_malloc(sizeof(ValueT) * a.num_rows * num_vectors, 4096);
 
     // Warmup/correctness
     memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows * num_vectors);
-    OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, vector_x_row_major);
+    OmpMergeCsrmm(g_omp_threads, clustered_matrix, clustered_matrix.row_offsets + 1, clustered_matrix.column_indices, clustered_matrix.values, vector_x, clustered_vector_y_out, num_vectors, scratch);
+
+    CpuTimer permute_timer;
+    permute_timer.Start();
+    UnpermuteRows(vector_y_out, clustered_vector_y_out, row_relabel_indices, a.num_rows, num_vectors, g_output_row_major, g_omp_threads);
+    permute_timer.Stop();
+
     if (!g_quiet)
     {
+        printf("\t%.4f ms to permute Y\n", permute_timer.ElapsedMillis());
+
         // Check answer
-        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
+        int compare = CompareSpmmResults(g_omp_threads, a, vector_x, reference_vector_y_out, vector_y_out, num_vectors) != 0;
         printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
-        if (g_input_row_major == g_output_row_major){
-            for(int i=0; i<a.num_rows; i++){
-                ValueT diff = reference_vector_y_out[i] - vector_y_out[i*num_vectors];
-                if(diff>0.000001 || diff<-0.0000001){
-                    printf("%lf, %lf, %d\n",reference_vector_y_out[i],vector_y_out[i*num_vectors],i);
-                }
-            }
-        }
     }
-    
+
     // Re-populate caches, etc.
     for(int it = 0; it < timing_iterations; ++it)
     {
-        OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, vector_x_row_major);
+        OmpMergeCsrmm(g_omp_threads, clustered_matrix, clustered_matrix.row_offsets + 1, clustered_matrix.column_indices, clustered_matrix.values, vector_x, clustered_vector_y_out, num_vectors, scratch);
     }
 
     // Timing
     float elapsed_ms = 0.0;
-    CpuTimer timer;
     timer.Start();
     for(int it = 0; it < timing_iterations; ++it)
     {
-        OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out, num_vectors, vector_x_row_major);
+        OmpMergeCsrmm(g_omp_threads, clustered_matrix, clustered_matrix.row_offsets + 1, clustered_matrix.column_indices, clustered_matrix.values, vector_x, clustered_vector_y_out, num_vectors, scratch);
     }
     timer.Stop();
     elapsed_ms += timer.ElapsedMillis();
 
+    // Cleanup
+    delete[] row_relabel_indices;
+    mkl_free(clustered_vector_y_out);
+
     return elapsed_ms / timing_iterations;
 }
 
+
 //---------------------------------------------------------------------
 // Test generation
 //---------------------------------------------------------------------
@@ -883,6 +4036,126 @@ void DisplayPerf(
 }
 
 
+/**
+ * Run the GNN aggregation tests for the given normalization: "mean" scales
+ * row i by 1/deg(i), "sym" applies D^-1/2 A D^-1/2 (columns folded into a
+ * scaled copy of A's values, rows in the epilogue), "none" skips scaling.
+ * Every test adds a bias and applies ReLU.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void RunGnnTests(
+    CsrMatrix<ValueT, OffsetT>&     csr_matrix,
+    ValueT*                         vector_x,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    int                             num_vectors,
+    const std::string&              gnn_norm)
+{
+    if ((gnn_norm != "mean") && (gnn_norm != "sym") && (gnn_norm != "none"))
+    {
+        fprintf(stderr, "Unknown GNN normalization '%s' (expected mean, sym or none)\n", gnn_norm.c_str());
+        exit(1);
+    }
+
+    std::vector<ValueT> row_scale(csr_matrix.num_rows, ValueT(1));
+    std::vector<ValueT> values(csr_matrix.values, csr_matrix.values + csr_matrix.num_nonzeros);
+    std::vector<ValueT> bias(num_vectors);
+    for (int k = 0; k < num_vectors; ++k)
+        bias[k] = ValueT((k % 7) - 3);
+
+    for (OffsetT row = 0; row < csr_matrix.num_rows; ++row)
+    {
+        OffsetT degree = csr_matrix.row_offsets[row + 1] - csr_matrix.row_offsets[row];
+        if (degree > 0)
+            row_scale[row] = (gnn_norm == "sym") ? ValueT(1.0 / sqrt(double(degree))) : ValueT(1.0 / degree);
+    }
+
+    if (gnn_norm == "sym")
+    {
+        std::vector<OffsetT> col_degree(csr_matrix.num_cols, 0);
+        for (OffsetT nz = 0; nz < csr_matrix.num_nonzeros; ++nz)
+            col_degree[csr_matrix.column_indices[nz]]++;
+        for (OffsetT nz = 0; nz < csr_matrix.num_nonzeros; ++nz)
+            values[nz] *= ValueT(1.0 / sqrt(double(col_degree[csr_matrix.column_indices[nz]])));
+    }
+
+    float avg_ms, unfused_ms;
+
+    if (!g_quiet) printf("\n\n");
+    printf("Merge CsrMM + %s/bias/relu passes vs fused, ", gnn_norm.c_str()); fflush(stdout);
+    if (gnn_norm == "none")
+        avg_ms = TestOmpMergeGnnCsrmm(csr_matrix, &values[0], NoRowScale<ValueT>(), &bias[0], vector_x, vector_y_out, timing_iterations, unfused_ms, num_vectors);
+    else
+        avg_ms = TestOmpMergeGnnCsrmm(csr_matrix, &values[0], RowScale<ValueT>(&row_scale[0]), &bias[0], vector_x, vector_y_out, timing_iterations, unfused_ms, num_vectors);
+
+    DisplayPerf(0.0, unfused_ms, csr_matrix, num_vectors);
+    if (!g_quiet) printf("\n");
+    printf("Merge fused-epilogue CsrMM, "); fflush(stdout);
+    DisplayPerf(0.0, avg_ms, csr_matrix, num_vectors);
+}
+
+
+/**
+ * Run a GraphSAGE-style neighbor aggregation through the merge-path kernel:
+ * "sum" and "mean" over (+, *) (mean scales row i by 1/deg(i) in the
+ * epilogue), "max" and "min" over (max, *) and (min, *).  Rows without
+ * nonzeros come out as the semiring identity (0 or -/+infinity).
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void RunAggregateTests(
+    CsrMatrix<ValueT, OffsetT>&     csr_matrix,
+    ValueT*                         vector_x,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    int                             num_vectors,
+    const std::string&              aggregate)
+{
+    float avg_ms;
+
+    if (!g_quiet) printf("\n\n");
+    printf("Merge %s-aggregate CsrMM, ", aggregate.c_str()); fflush(stdout);
+
+    if (aggregate == "sum")
+    {
+        avg_ms = TestOmpMergeSemiringCsrmm(csr_matrix, PlusTimes<ValueT>(), NoEpilogue(), vector_x, vector_y_out, timing_iterations, num_vectors);
+    }
+    else if (aggregate == "mean")
+    {
+        typedef SpmmEpilogue<RowScale<ValueT>, NoBias<ValueT>, IdentityActivation<ValueT> > MeanEpilogueT;
+
+        std::vector<ValueT> row_scale(csr_matrix.num_rows, ValueT(1));
+        for (OffsetT row = 0; row < csr_matrix.num_rows; ++row)
+        {
+            OffsetT degree = csr_matrix.row_offsets[row + 1] - csr_matrix.row_offsets[row];
+            if (degree > 0)
+                row_scale[row] = ValueT(1.0 / degree);
+        }
+
+        MeanEpilogueT mean_epilogue((RowScale<ValueT>(&row_scale[0])));
+        avg_ms = TestOmpMergeSemiringCsrmm(csr_matrix, PlusTimes<ValueT>(), mean_epilogue, vector_x, vector_y_out, timing_iterations, num_vectors);
+    }
+    else if (aggregate == "max")
+    {
+        avg_ms = TestOmpMergeSemiringCsrmm(csr_matrix, MaxTimes<ValueT>(), NoEpilogue(), vector_x, vector_y_out, timing_iterations, num_vectors);
+    }
+    else if (aggregate == "min")
+    {
+        avg_ms = TestOmpMergeSemiringCsrmm(csr_matrix, MinTimes<ValueT>(), NoEpilogue(), vector_x, vector_y_out, timing_iterations, num_vectors);
+    }
+    else
+    {
+        fprintf(stderr, "Unknown aggregate '%s' (expected sum, mean, max or min)\n", aggregate.c_str());
+        exit(1);
+    }
+
+    DisplayPerf(0.0, avg_ms, csr_matrix, num_vectors);
+}
+
+
 /**
  * Run tests
  */
@@ -890,8 +4163,6 @@ template <
     typename ValueT,
     typename OffsetT>
 void RunTests(
-    ValueT              alpha,
-    ValueT              beta,
     const std::string&  mtx_filename,
     int                 grid2d,
     int                 grid3d,
@@ -899,6 +4170,7 @@ void RunTests(
     int                 dense,
     int                 timing_iterations,
     int                 num_vectors,
+    int                 k_panel,
     CommandLineArgs&    args)
 {
     // Initialize matrix in COO form
@@ -931,7 +4203,7 @@ void RunTests(
     else if (wheel > 0)
     {
         // Generate wheel graph
-        printf("wheel_%d, ", grid2d); fflush(stdout);
+        printf("wheel_%d, ", wheel); fflush(stdout);
         coo_matrix.InitWheel(wheel);
     }
     else if (dense > 0)
@@ -994,40 +4266,51 @@ void RunTests(
 
     // Allocate input and output vectors (if available, use NUMA allocation to force storage on the 
     // sockets for performance consistency)
-    ValueT *vector_x, *vector_y_in, *reference_vector_y_out, *vector_y_out, *vector_x_row_major;
+    ValueT *vector_x, *reference_vector_y_out, *vector_y_out, *vector_x_row_major;
     if (csr_matrix.IsNumaMalloc())
     {
         vector_x                = (ValueT*) numa_alloc_onnode(sizeof(ValueT) * csr_matrix.num_cols * num_vectors, 0);
-        vector_y_in             = (ValueT*) numa_alloc_onnode(sizeof(ValueT) * csr_matrix.num_rows, 0);
-        reference_vector_y_out  = (ValueT*) numa_alloc_onnode(sizeof(ValueT) * csr_matrix.num_rows, 0);
+        reference_vector_y_out  = (ValueT*) numa_alloc_onnode(sizeof(ValueT) * csr_matrix.num_rows * num_vectors, 0);
         vector_y_out            = (ValueT*) numa_alloc_onnode(sizeof(ValueT) * csr_matrix.num_rows * num_vectors, 0);
         vector_x_row_major      = (ValueT*) numa_alloc_onnode(sizeof(ValueT) * csr_matrix.num_cols * num_vectors, 0);
     }
     else
     {
         vector_x                = (ValueT*) mkl_malloc(sizeof(ValueT) * csr_matrix.num_cols * num_vectors, 4096);
-        vector_y_in             = (ValueT*) mkl_malloc(sizeof(ValueT) * csr_matrix.num_rows, 4096);
-        reference_vector_y_out  = (ValueT*) mkl_malloc(sizeof(ValueT) * csr_matrix.num_rows, 4096);
+        reference_vector_y_out  = (ValueT*) mkl_malloc(sizeof(ValueT) * csr_matrix.num_rows * num_vectors, 4096);
         vector_y_out            = (ValueT*) mkl_malloc(sizeof(ValueT) * csr_matrix.num_rows * num_vectors, 4096);
         vector_x_row_major      = (ValueT*) mkl_malloc(sizeof(ValueT) * csr_matrix.num_cols * num_vectors, 4096);
     }
 
-    for (int col = 0; col < csr_matrix.num_cols * num_vectors; ++col){
-        // vector_x[col] = col / csr_matrix.num_cols + 1.0;
-        vector_x[col] = 10.0;
-        if (g_input_row_major){
-            vector_x_row_major[col] = 10.0;
+    // X in the input layout (and its row-major copy, when that is the same thing)
+    for (int col = 0; col < csr_matrix.num_cols; ++col)
+    {
+        for (int k = 0; k < num_vectors; ++k)
+        {
+            size_t i = g_input_row_major ? size_t(col) * num_vectors + k : size_t(k) * csr_matrix.num_cols + col;
+            vector_x[i] = SpmmInputValue<ValueT>(col, k);
+            if (g_input_row_major)
+                vector_x_row_major[i] = vector_x[i];
         }
     }
 
-    for (int row = 0; row < csr_matrix.num_rows; ++row)
-        vector_y_in[row] = 1;
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
 
-    // Compute reference answer
-    SpmvGold(csr_matrix, vector_x, vector_y_in, reference_vector_y_out, alpha, beta);
+    // Compute reference answer (all num_vectors columns)
+    SpmmGold(g_omp_threads, csr_matrix, vector_x, reference_vector_y_out, num_vectors);
 
     float avg_ms, setup_ms;
 
+    // Layout conversion benchmark (restores the row-major copy of X afterwards)
+    if (args.CheckCmdLineFlag("transpose_bench"))
+    {
+        if (!g_quiet) printf("\n\n");
+        TestTranspose(vector_x_row_major, vector_x, csr_matrix.num_cols, num_vectors, timing_iterations);
+        if (g_input_row_major)
+            memcpy(vector_x_row_major, vector_x, sizeof(ValueT) * csr_matrix.num_cols * num_vectors);
+    }
+
     // Simple SpMMT
     if (!g_quiet) printf("\n\n");
     printf("Simple CsrMMT, "); fflush(stdout);
@@ -1037,7 +4320,22 @@ void RunTests(
     // Merge SpMM
     if (!g_quiet) printf("\n\n");
     printf("Merge CsrMM, "); fflush(stdout);
-    avg_ms = TestOmpMergeCsrmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms, num_vectors, vector_x_row_major);
+    avg_ms = TestOmpMergeCsrmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms, num_vectors);
+    DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
+
+    // 2D merge-path x K-chunk SpMM
+    if (!g_quiet) printf("\n\n");
+    printf("Merge 2D CsrMM, "); fflush(stdout);
+    avg_ms = TestOmpMerge2dCsrmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms, num_vectors, vector_x_row_major);
+    DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
+
+    // K-panel merge SpMM (a thread's recently gathered X panel rows should stay in
+    // half of L2; assume a reuse window of 1024 rows, in whole 64-column tiles)
+    if (k_panel <= 0)
+        k_panel = std::max(64, int(g_l2_bytes / 2 / (1024 * sizeof(ValueT))) / 64 * 64);
+    if (!g_quiet) printf("\n\n");
+    printf("Merge K-panel CsrMM, "); fflush(stdout);
+    avg_ms = TestOmpMergePanelCsrmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms, num_vectors, vector_x_row_major, k_panel);
     DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
 
     // Row-based SpMM
@@ -1055,18 +4353,163 @@ void RunTests(
         DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
     }
 
+    // Symmetric SpMM over upper-triangle storage (compare against Merge CsrMM)
+    if (csr_matrix.IsSymmetric())
+    {
+        if (!g_quiet) printf("\n\n");
+        printf("Symmetric CsrMM, "); fflush(stdout);
+        avg_ms = TestOmpSymmetricCsrmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms, num_vectors, vector_x_row_major);
+        DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
+    }
+    else if (!g_quiet)
+    {
+        printf("\n\nSymmetric CsrMM skipped (matrix is not symmetric)\n");
+    }
+
+    // Transposed SpMM (Y = A^T X), directly from A vs through an explicit A^T
+    if (args.CheckCmdLineFlag("transposed"))
+    {
+        float explicit_setup_ms, explicit_ms;
+
+        if (!g_quiet) printf("\n\n");
+        printf("Explicit A^T + Merge CsrMM vs direct, "); fflush(stdout);
+        avg_ms = TestOmpMergeTransposeCsrmm(csr_matrix, timing_iterations, setup_ms, explicit_setup_ms, explicit_ms, num_vectors);
+        DisplayPerf(explicit_setup_ms, explicit_ms, csr_matrix, num_vectors);
+        if (!g_quiet) printf("\n");
+        printf("Merge transposed CsrMM, "); fflush(stdout);
+        DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
+    }
+
+    // Mixed precision: fp32 X with fp64 accumulation and output
+    std::string precision;
+    args.GetCmdLineArgument("precision", precision);
+    if (precision == "mixed")
+    {
+        if (!g_quiet) printf("\n\n");
+        if (sizeof(ValueT) == sizeof(double))
+        {
+            printf("Mixed-precision Merge CsrMM, "); fflush(stdout);
+            avg_ms = TestOmpMergeMixedCsrmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms, num_vectors);
+            DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
+        }
+        else if (!g_quiet)
+        {
+            printf("Mixed-precision Merge CsrMM skipped (needs --fp64)\n");
+        }
+    }
+    else if (!precision.empty() && (precision != "fp64"))
+    {
+        fprintf(stderr, "Unknown precision '%s' (expected fp64 or mixed)\n", precision.c_str());
+        exit(1);
+    }
+
+    // Merge SpMM with non-temporal stores for finished output rows vs normal stores
+    if (args.CheckCmdLineFlag("nt_stores"))
+    {
+        float normal_ms;
+
+        if (!g_quiet) printf("\n\n");
+        printf("Normal-store vs streaming-store Merge CsrMM, "); fflush(stdout);
+        avg_ms = TestOmpMergeStreamingCsrmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, normal_ms, num_vectors);
+        DisplayPerf(0.0, normal_ms, csr_matrix, num_vectors);
+        if (!g_quiet) printf("\n");
+        printf("Merge streaming-store CsrMM, "); fflush(stdout);
+        DisplayPerf(0.0, avg_ms, csr_matrix, num_vectors);
+    }
+
+    // Merge SpMM on views into wider X and Y (leading dimensions) vs staging through packed copies
+    int ld_pad = 0;
+    args.GetCmdLineArgument("ld_pad", ld_pad);
+    if (ld_pad > 0)
+    {
+        float staged_ms;
+
+        if (!g_quiet) printf("\n\n");
+        printf("Staged-copy vs strided Merge CsrMM, "); fflush(stdout);
+        avg_ms = TestOmpStridedCsrmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, ld_pad, staged_ms, num_vectors);
+        DisplayPerf(0.0, staged_ms, csr_matrix, num_vectors);
+        if (!g_quiet) printf("\n");
+        printf("Strided Merge CsrMM, "); fflush(stdout);
+        DisplayPerf(0.0, avg_ms, csr_matrix, num_vectors);
+    }
+
+    // Adaptive sparse tiling: dense column tiles per row panel plus a CSR remainder
+    int aspt_reuse = 0;
+    int aspt_panel = 64;
+    args.GetCmdLineArgument("aspt", aspt_reuse);
+    args.GetCmdLineArgument("aspt_panel", aspt_panel);
+    if (aspt_reuse > 0)
+    {
+        if (!g_quiet) printf("\n\n");
+        printf("Adaptive tiled CsrMM, "); fflush(stdout);
+        avg_ms = TestOmpAdaptiveTiledCsrmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms, num_vectors, aspt_panel, aspt_reuse);
+        DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
+    }
+
+    // Row clustering: merge SpMM on rows grouped by MinHash similarity of their column sets
+    int row_cluster = 0;
+    args.GetCmdLineArgument("row_cluster", row_cluster);
+    if (row_cluster > 0)
+    {
+        if (!g_quiet) printf("\n\n");
+        printf("Row-clustered Merge CsrMM, "); fflush(stdout);
+        avg_ms = TestOmpClusteredCsrmm(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms, num_vectors, row_cluster);
+        DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors);
+    }
+
+    // GNN aggregation: merge SpMM with a fused normalization/bias/ReLU epilogue
+    std::string gnn_norm;
+    args.GetCmdLineArgument("gnn", gnn_norm);
+    if (!gnn_norm.empty())
+        RunGnnTests(csr_matrix, vector_x, vector_y_out, timing_iterations, num_vectors, gnn_norm);
+
+    std::string aggregate;
+    args.GetCmdLineArgument("aggregate", aggregate);
+    if (!aggregate.empty())
+        RunAggregateTests(csr_matrix, vector_x, vector_y_out, timing_iterations, num_vectors, aggregate);
+
+    // GNN layer Y = A X W: fused, in the cheaper association order
+    int gnn_layer = 0;
+    args.GetCmdLineArgument("gnn_layer", gnn_layer);
+    if (gnn_layer > 0)
+    {
+        float unfused_ms, other_ms;
+
+        if (!g_quiet) printf("\n\n");
+        printf("Merge CsrMM + GEMM vs fused GNN layer, "); fflush(stdout);
+        avg_ms = TestOmpMergeGnnLayerCsrmm(csr_matrix, vector_x, timing_iterations, unfused_ms, other_ms, num_vectors, gnn_layer);
+        DisplayPerf(0.0, unfused_ms, csr_matrix, num_vectors);
+        if (!g_quiet) printf("\n");
+        printf("Merge GNN layer CsrMM, "); fflush(stdout);
+        DisplayPerf(0.0, avg_ms, csr_matrix, num_vectors);
+    }
+
+    // Batched SpMM: many value arrays and right-hand sides over one sparsity pattern
+    int batch_size = 0;
+    args.GetCmdLineArgument("batch", batch_size);
+    if (batch_size > 0)
+    {
+        float sequential_ms;
+
+        if (!g_quiet) printf("\n\n");
+        printf("Merge CsrMM x %d sequential vs batched, ", batch_size); fflush(stdout);
+        avg_ms = TestOmpMergeBatchedCsrmm(csr_matrix, batch_size, timing_iterations, setup_ms, sequential_ms, num_vectors);
+        DisplayPerf(0.0, sequential_ms, csr_matrix, num_vectors * batch_size);
+        if (!g_quiet) printf("\n");
+        printf("Merge batched CsrMM, "); fflush(stdout);
+        DisplayPerf(setup_ms, avg_ms, csr_matrix, num_vectors * batch_size);
+    }
+
     // Cleanup
     if (csr_matrix.IsNumaMalloc())
     {
         if (vector_x)                   numa_free(vector_x, sizeof(ValueT) * csr_matrix.num_cols * num_vectors);
-        if (vector_y_in)                numa_free(vector_y_in, sizeof(ValueT) * csr_matrix.num_rows);
-        if (reference_vector_y_out)     numa_free(reference_vector_y_out, sizeof(ValueT) * csr_matrix.num_rows);
+        if (reference_vector_y_out)     numa_free(reference_vector_y_out, sizeof(ValueT) * csr_matrix.num_rows * num_vectors);
         if (vector_y_out)               numa_free(vector_y_out, sizeof(ValueT) * csr_matrix.num_rows * num_vectors);
     }
     else
     {
         if (vector_x)                   mkl_free(vector_x);
-        if (vector_y_in)                mkl_free(vector_y_in);
         if (reference_vector_y_out)     mkl_free(reference_vector_y_out);
         if (vector_y_out)               mkl_free(vector_y_out);
     }
@@ -1091,8 +4534,22 @@ int main(int argc, char **argv)
             "[--threads=<OMP threads>] "
             "[--i=<timing iterations>] "
             "[--fp64 (default) | --fp32] "
-            "[--alpha=<alpha scalar (default: 1.0)>] "
-            "[--beta=<beta scalar (default: 0.0)>] "
+            "[--num_vectors=<dense columns (default: 32)>] "
+            "[--k_panel=<dense columns per K-panel (default: sized to L2)>] "
+            "[--input_col_major] "
+            "[--output_col_major] "
+            "[--transpose_bench] "
+            "[--gnn=<mean|sym|none: GNN aggregation with fused epilogue>] "
+            "[--aggregate=<sum|mean|max|min: semiring neighbor aggregation>] "
+            "[--batch=<B: batched SpMM over B value arrays sharing A's pattern>] "
+            "[--gnn_layer=<k_out: GNN layer A X W with num_vectors x k_out W, association order by cost>] "
+            "[--transposed: Y = A^T X directly from A vs an explicit transpose] "
+            "[--precision=<fp64|mixed: mixed adds merge SpMM on an fp32 X with fp64 accumulation>] "
+            "[--nt_stores: merge SpMM writing finished Y rows with non-temporal stores] "
+            "[--ld_pad=<n: merge SpMM on X/Y views with leading dimensions padded by n>] "
+            "[--aspt=<r: adaptive sparse tiling, columns reused >= r times in a row panel form dense tiles>] "
+            "[--aspt_panel=<rows per adaptive tiling panel (default: 64)>] "
+            "[--row_cluster=<b: merge SpMM on rows clustered by MinHash with b bands of 2 hashes>] "
             "\n\t"
                 "--mtx=<matrix market file> "
             "\n\t"
@@ -1114,9 +4571,8 @@ int main(int argc, char **argv)
     int                 wheel               = -1;
     int                 dense               = -1;
     int                 timing_iterations   = -1;
-    float               alpha               = 1.0;
-    float               beta                = 0.0;
     int                 num_vectors         = 32;
+    int                 k_panel             = -1;
 
     g_verbose = args.CheckCmdLineFlag("v");
     g_verbose2 = args.CheckCmdLineFlag("v2");
@@ -1126,20 +4582,26 @@ int main(int argc, char **argv)
     args.GetCmdLineArgument("mtx", mtx_filename);
     args.GetCmdLineArgument("grid2d", grid2d);
     args.GetCmdLineArgument("grid3d", grid3d);
+    args.GetCmdLineArgument("wheel", wheel);
     args.GetCmdLineArgument("dense", dense);
-    args.GetCmdLineArgument("alpha", alpha);
-    args.GetCmdLineArgument("beta", beta);
     args.GetCmdLineArgument("threads", g_omp_threads);
     args.GetCmdLineArgument("num_vectors", num_vectors);
+    args.GetCmdLineArgument("k_panel", k_panel);
+    g_input_row_major = !args.CheckCmdLineFlag("input_col_major");
+    g_output_row_major = !args.CheckCmdLineFlag("output_col_major");
+
+    long l2_bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2_bytes > 0)
+        g_l2_bytes = l2_bytes;
 
     // Run test(s)
     if (fp32)
     {
-        RunTests<float, int>(alpha, beta, mtx_filename, grid2d, grid3d, wheel, dense, timing_iterations, num_vectors, args);
+        RunTests<float, int>(mtx_filename, grid2d, grid3d, wheel, dense, timing_iterations, num_vectors, k_panel, args);
     }
     else
     {
-        RunTests<double, int>(alpha, beta, mtx_filename, grid2d, grid3d, wheel, dense, timing_iterations, num_vectors, args);
+        RunTests<double, int>(mtx_filename, grid2d, grid3d, wheel, dense, timing_iterations, num_vectors, k_panel, args);
     }
 
     printf("\n");
@@ -57,10 +57,12 @@
 #include <sstream>
 #include <iostream>
 #include <limits>
+#include <unistd.h>
 
 #include <mkl.h>
 
 #include "sparse_matrix.h"
+#include "reorder.h"
 #include "utils.h"
 
 
@@ -74,6 +76,7 @@ bool                    g_verbose           = false;        // Whether to displa
 bool                    g_verbose2          = false;        // Whether to display input to console
 int                     g_omp_threads       = -1;           // Number of openMP threads
 int                     g_expected_calls    = 1000000;
+size_t                  g_llc_bytes         = 32 << 20;     // Last-level cache size used to size column panels
 
 
 //---------------------------------------------------------------------
@@ -276,6 +279,54 @@ void SpmvGold(
     }
 }
 
+
+/**
+ * Compare an SpMV result y = Ax against SpmvGold row by row.  Two summations
+ * of a row of n nonzeros in different orders can differ by up to about
+ * 2 * n * eps * sum(|a_ij * x_j|), so each row is allowed that much error
+ * (with a little headroom).  Returns the number of mismatched rows, printing
+ * the first few if verbose.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+OffsetT CompareSpmvResults(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    bool                            verbose = true)
+{
+    const double    eps             = std::numeric_limits<ValueT>::epsilon();
+    const int       max_reported    = 8;
+
+    OffsetT errors = 0;
+    for (OffsetT row = 0; row < a.num_rows; ++row)
+    {
+        double magnitude = 0.0;
+        for (OffsetT offset = a.row_offsets[row]; offset < a.row_offsets[row + 1]; ++offset)
+            magnitude += fabs(double(a.values[offset]) * double(vector_x[a.column_indices[offset]]));
+
+        ValueT  expected    = reference_vector_y_out[row];
+        ValueT  computed    = vector_y_out[row];
+        double  tolerance   = 4.0 * (a.row_offsets[row + 1] - a.row_offsets[row] + 2) * eps * magnitude;
+
+        // Written this way round so that NaN fails
+        if (!((computed == expected) || (fabs(double(computed) - double(expected)) <= tolerance)))
+        {
+            if (verbose && (errors < max_reported))
+                printf("\tINCORRECT: row %lld: %.10g != %.10g (tolerance %.3g)\n",
+                    (long long) row, double(computed), double(expected), tolerance);
+            errors++;
+        }
+    }
+
+    if (verbose && errors)
+        printf("\t%lld of %lld rows incorrect\n", (long long) errors, (long long) a.num_rows);
+
+    return errors;
+}
+
 //---------------------------------------------------------------------
 // CPU normal omp SpMV
 //---------------------------------------------------------------------
@@ -299,59 +350,1102 @@ void OmpCsrSpmv(
             offset < a.row_offsets[row + 1];
             ++offset)
         {
-            partial += a.values[offset] * vector_x[a.column_indices[offset]];
+            partial += a.values[offset] * vector_x[a.column_indices[offset]];
+        }
+        vector_y_out[row] = partial;
+    }
+}
+
+
+/**
+ * Run OmpCsrSpmv
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpCsrSpmv(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms)
+{
+    setup_ms = 0.0;
+
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+    int num_threads = g_omp_threads;
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
+    OmpCsrSpmv(g_omp_threads, a, vector_x, vector_y_out);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+ 
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpCsrSpmv(g_omp_threads, a, vector_x, vector_y_out);
+    }
+    
+    // Timing
+    float elapsed_ms = 0.0;
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpCsrSpmv(g_omp_threads, a, vector_x, vector_y_out);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    return elapsed_ms / timing_iterations;
+}
+
+
+
+//---------------------------------------------------------------------
+// CPU merge-based SpMV
+//---------------------------------------------------------------------
+
+
+/**
+ * OpenMP CPU merge-based SpMV
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMergeCsrmv(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    ValueT*     __restrict        values,
+    ValueT*     __restrict        vector_x,
+    ValueT*     __restrict        vector_y_out)
+{
+    // Temporary storage for inter-thread fix-up after load-balanced work
+    OffsetT     row_carry_out[256];     // The last row-id each worked on by each thread when it finished its path segment
+    ValueT      value_carry_out[256];   // The running total within each thread when it finished its path segment
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        // Merge list B (NZ indices)
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+
+        OffsetT num_merge_items     = a.num_rows + a.num_nonzeros;                          // Merge path total length
+        OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;    // Merge items per thread
+
+        // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
+        int2    thread_coord;
+        int2    thread_coord_end;
+        int     start_diagonal      = std::min(items_per_thread * tid, num_merge_items);
+        int     end_diagonal        = std::min(start_diagonal + items_per_thread, num_merge_items);
+
+        MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord);
+        MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord_end);
+
+        // Consume whole rows
+        for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+        {
+            ValueT running_total = 0.0;
+            for (; thread_coord.y < row_end_offsets[thread_coord.x]; ++thread_coord.y)
+            {
+                running_total += values[thread_coord.y] * vector_x[column_indices[thread_coord.y]];
+            }
+
+            vector_y_out[thread_coord.x] = running_total;
+        }
+
+        // Consume partial portion of thread's last row
+        ValueT running_total = 0.0;
+        for (; thread_coord.y < thread_coord_end.y; ++thread_coord.y)
+        {
+            running_total += values[thread_coord.y] * vector_x[column_indices[thread_coord.y]];
+        }
+
+        // Save carry-outs
+        row_carry_out[tid] = thread_coord_end.x;
+        value_carry_out[tid] = running_total;
+    }
+
+    // Carry-out fix-up (rows spanning multiple threads)
+    for (int tid = 0; tid < num_threads - 1; ++tid)
+    {
+        if (row_carry_out[tid] < a.num_rows)
+            vector_y_out[row_carry_out[tid]] += value_carry_out[tid];
+    }
+}
+
+
+/**
+ * Run OmpMergeCsrmv
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpMergeCsrmv(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms)
+{
+    setup_ms = 0.0;
+
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+    int num_threads = g_omp_threads;
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
+    OmpMergeCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+ 
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    return elapsed_ms / timing_iterations;
+}
+
+template <
+    typename AIteratorT,
+    typename BIteratorT,
+    typename OffsetT,
+    typename CoordinateT>
+inline void RowPathSearch(
+    AIteratorT      a,                  ///< [in]List A
+    BIteratorT      b,                  ///< [in]List B
+    OffsetT         a_len,              ///< [in]Length of A
+    CoordinateT&    path_coordinate)    ///< [out] (x,y) coordinate where diagonal intersects the merge path
+{
+    OffsetT x_min = 0;
+    OffsetT x_max = a_len;
+
+    while (x_min < x_max)
+    {
+        OffsetT x_pivot = (x_min + x_max) >> 1;
+        if (a[x_pivot] <= b[path_coordinate.y - 1])
+            x_min = x_pivot + 1;    // Contract range up A (down B)
+        else
+            x_max = x_pivot;        // Contract range down A (up B)
+    }
+
+    path_coordinate.x = std::min(x_min, a_len);
+}
+
+/**
+ * OpenMP CPU row-based SpMM
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpNonzeroSplitCsrmm(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    ValueT*     __restrict        values,
+    ValueT*     __restrict        vector_x,
+    ValueT*     __restrict        vector_y_out)
+{
+    // Temporary storage for inter-thread fix-up after load-balanced work
+    OffsetT     row_carry_out[256];     // The last row-id each worked on by each thread when it finished its path segment
+    ValueT      value_carry_out[256];   // The running total within each thread when it finished its path segment
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        // Merge list B (NZ indices)
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+
+        OffsetT num_nonzeros     = a.num_nonzeros;                          
+        OffsetT items_per_thread    = (num_nonzeros + num_threads - 1) / num_threads;
+
+        // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
+        int2    thread_coord;
+        int2    thread_coord_end;
+        thread_coord.y            = std::min(items_per_thread * tid, num_nonzeros);
+        thread_coord_end.y        = std::min(thread_coord.y + items_per_thread, num_nonzeros);
+
+        RowPathSearch(row_end_offsets, nonzero_indices, a.num_rows, thread_coord);
+        RowPathSearch(row_end_offsets, nonzero_indices, a.num_rows, thread_coord_end);
+
+                // Consume whole rows
+        for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+        {
+            ValueT running_total = 0.0;
+            for (; thread_coord.y < row_end_offsets[thread_coord.x]; ++thread_coord.y)
+            {
+                running_total += values[thread_coord.y] * vector_x[column_indices[thread_coord.y]];
+            }
+
+            vector_y_out[thread_coord.x] = running_total;
+        }
+
+        // Consume partial portion of thread's last row
+        ValueT running_total = 0.0;
+        for (; thread_coord.y < thread_coord_end.y; ++thread_coord.y)
+        {
+            running_total += values[thread_coord.y] * vector_x[column_indices[thread_coord.y]];
+        }
+
+        // Save carry-outs
+        row_carry_out[tid] = thread_coord_end.x;
+        value_carry_out[tid] = running_total;
+    }
+
+    // Carry-out fix-up (rows spanning multiple threads)
+    for (int tid = 0; tid < num_threads - 1; ++tid)
+    {
+        if (row_carry_out[tid] < a.num_rows)
+            vector_y_out[row_carry_out[tid]] += value_carry_out[tid];
+    }
+}
+
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestOmpNonzeroSplitCsrmm(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms)
+{
+    setup_ms = 0.0;
+
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+    int num_threads = g_omp_threads;
+
+    if (!g_quiet)
+        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
+    OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+    
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    return elapsed_ms / timing_iterations;
+}
+
+//---------------------------------------------------------------------
+// MKL SpMV
+//---------------------------------------------------------------------
+
+/**
+ * MKL CPU SpMV (specialized for fp32)
+ */
+template <typename OffsetT>
+void MklCsrmv(
+    int                           num_threads,
+    CsrMatrix<float, OffsetT>&    a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    float*      __restrict        values,
+    float*      __restrict        vector_x,
+    float*      __restrict        vector_y_out)
+{
+    mkl_cspblas_scsrgemv("n", &a.num_rows, a.values, a.row_offsets, a.column_indices, vector_x, vector_y_out);
+}
+
+/**
+ * MKL CPU SpMV (specialized for fp64)
+ */
+template <typename OffsetT>
+void MklCsrmv(
+    int                           num_threads,
+    CsrMatrix<double, OffsetT>&   a,
+    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
+    OffsetT*    __restrict        column_indices,
+    double*     __restrict        values,
+    double*     __restrict        vector_x,
+    double*     __restrict        vector_y_out)
+{
+    mkl_cspblas_dcsrgemv("n", &a.num_rows, a.values, a.row_offsets, a.column_indices, vector_x, vector_y_out);
+}
+
+/**
+ * MKL dense GEMV y = A x for a row-major m x n A (specialized for fp32)
+ */
+inline void DenseGemv(
+    int             m,
+    int             n,
+    const float*    a,
+    const float*    x,
+    float*          y)
+{
+    cblas_sgemv(CblasRowMajor, CblasNoTrans, m, n, 1.0f, a, n, x, 1, 0.0f, y, 1);
+}
+
+/**
+ * MKL dense GEMV y = A x for a row-major m x n A (specialized for fp64)
+ */
+inline void DenseGemv(
+    int             m,
+    int             n,
+    const double*   a,
+    const double*   x,
+    double*         y)
+{
+    cblas_dgemv(CblasRowMajor, CblasNoTrans, m, n, 1.0, a, n, x, 1, 0.0, y, 1);
+}
+
+
+
+/**
+ * Run MKL CsrMV
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestMklCsrmv(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms)
+{
+    setup_ms = 0.0;
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
+    MklCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+
+        // memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
+    }
+
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        MklCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        MklCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    return elapsed_ms / timing_iterations;
+}
+
+
+//---------------------------------------------------------------------
+// Reordered merge-based SpMV
+//---------------------------------------------------------------------
+
+/**
+ * Run OmpMergeCsrmv on a reordered copy of the matrix (see Relabel() for the
+ * available methods).  x is permuted into the new order on the way in and y is
+ * permuted back on the way out; the reordering itself is reported as setup
+ * time.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestReorderedMergeCsrmv(
+    const std::string&              method,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    // Reorder
+    CpuTimer setup_timer;
+    setup_timer.Start();
+
+    OffsetT* relabel_indices = new OffsetT[a.num_rows];
+    if (!Relabel(method, a, relabel_indices, g_omp_threads))
+    {
+        fprintf(stderr, "Unknown reordering: %s\n", method.c_str());
+        exit(1);
+    }
+
+    CooMatrix<ValueT, OffsetT> reordered_coo;
+    reordered_coo.InitCsrRelabel(a, relabel_indices);
+    CsrMatrix<ValueT, OffsetT> reordered_matrix(reordered_coo);
+    reordered_coo.Clear();
+
+    setup_timer.Stop();
+    setup_ms = setup_timer.ElapsedMillis();
+
+    if (!g_quiet)
+    {
+        printf("\tbandwidth: %d -> %d, profile: %lld -> %lld\n",
+            (int) a.Bandwidth(), (int) reordered_matrix.Bandwidth(),
+            a.Profile(), reordered_matrix.Profile());
+    }
+
+    // Permute x and run
+    ValueT* reordered_vector_x      = (ValueT*) mkl_malloc(sizeof(ValueT) * a.num_cols, 4096);
+    ValueT* reordered_vector_y_out  = (ValueT*) mkl_malloc(sizeof(ValueT) * a.num_rows, 4096);
+
+    float permute_ms = 0.0;
+    CpuTimer permute_timer;
+    permute_timer.Start();
+    PermuteVector(reordered_vector_x, vector_x, relabel_indices, a.num_cols, g_omp_threads);
+    permute_timer.Stop();
+    permute_ms += permute_timer.ElapsedMillis();
+
+    memset(reordered_vector_y_out, -1, sizeof(ValueT) * a.num_rows);
+    OmpMergeCsrmv(g_omp_threads, reordered_matrix, reordered_matrix.row_offsets + 1, reordered_matrix.column_indices, reordered_matrix.values, reordered_vector_x, reordered_vector_y_out);
+
+    permute_timer.Start();
+    UnpermuteVector(vector_y_out, reordered_vector_y_out, relabel_indices, a.num_rows, g_omp_threads);
+    permute_timer.Stop();
+    permute_ms += permute_timer.ElapsedMillis();
+
+    if (!g_quiet)
+    {
+        printf("\tUsing %d threads on %d procs, %.4f ms to permute x/y\n", g_omp_threads, omp_get_num_procs(), permute_ms);
+
+        // Check answer
+        OffsetT compare = CompareSpmvResults(a, vector_x, reference_vector_y_out, vector_y_out, true);
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmv(g_omp_threads, reordered_matrix, reordered_matrix.row_offsets + 1, reordered_matrix.column_indices, reordered_matrix.values, reordered_vector_x, reordered_vector_y_out);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpMergeCsrmv(g_omp_threads, reordered_matrix, reordered_matrix.row_offsets + 1, reordered_matrix.column_indices, reordered_matrix.values, reordered_vector_x, reordered_vector_y_out);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    // Cleanup
+    delete[] relabel_indices;
+    mkl_free(reordered_vector_x);
+    mkl_free(reordered_vector_y_out);
+
+    return elapsed_ms / timing_iterations;
+}
+
+
+//---------------------------------------------------------------------
+// Row-binned SpMV
+//---------------------------------------------------------------------
+
+/**
+ * Rows grouped into bins by length (empty, 1, 2-4, 5-16, 17-128, longer), in
+ * ascending row order within each bin.  The long-row bin also gets a
+ * running nonzero count so it can be merge-path split like a CSR of its own.
+ */
+template <typename OffsetT>
+struct RowBins
+{
+    enum
+    {
+        BIN_EMPTY,
+        BIN_1,
+        BIN_4,
+        BIN_16,
+        BIN_128,
+        BIN_LONG,
+        NUM_BINS
+    };
+
+    OffsetT     bin_offsets[NUM_BINS + 1];  // Offsets of each bin's first row in rows
+    OffsetT*    rows;                       // [num_rows] rows grouped by bin
+    OffsetT*    long_row_end_offsets;       // Running nonzero count over the long-row bin
+
+
+    static int Bin(OffsetT length)
+    {
+        if (length == 0)    return BIN_EMPTY;
+        if (length == 1)    return BIN_1;
+        if (length <= 4)    return BIN_4;
+        if (length <= 16)   return BIN_16;
+        if (length <= 128)  return BIN_128;
+        return BIN_LONG;
+    }
+
+
+    /**
+     * Initializer.  Each thread counts the bins of an even share of rows,
+     * the counts are scanned bin-major, and each thread scatters its rows.
+     */
+    template <typename ValueT>
+    void Init(
+        CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+        int                         num_threads)
+    {
+        std::vector<OffsetT> thread_bin_offsets(num_threads * NUM_BINS, 0);
+
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (int tid = 0; tid < num_threads; ++tid)
+        {
+            OffsetT row_begin   = OffsetT((long long) csr_matrix.num_rows * tid / num_threads);
+            OffsetT row_end     = OffsetT((long long) csr_matrix.num_rows * (tid + 1) / num_threads);
+            for (OffsetT row = row_begin; row < row_end; ++row)
+                thread_bin_offsets[tid * NUM_BINS + Bin(csr_matrix.row_offsets[row + 1] - csr_matrix.row_offsets[row])]++;
+        }
+
+        OffsetT running_rows = 0;
+        for (int bin = 0; bin < NUM_BINS; ++bin)
+        {
+            bin_offsets[bin] = running_rows;
+            for (int tid = 0; tid < num_threads; ++tid)
+            {
+                OffsetT count = thread_bin_offsets[tid * NUM_BINS + bin];
+                thread_bin_offsets[tid * NUM_BINS + bin] = running_rows;
+                running_rows += count;
+            }
+        }
+        bin_offsets[NUM_BINS] = running_rows;
+
+        rows = new OffsetT[csr_matrix.num_rows];
+
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (int tid = 0; tid < num_threads; ++tid)
+        {
+            OffsetT row_begin   = OffsetT((long long) csr_matrix.num_rows * tid / num_threads);
+            OffsetT row_end     = OffsetT((long long) csr_matrix.num_rows * (tid + 1) / num_threads);
+            for (OffsetT row = row_begin; row < row_end; ++row)
+                rows[thread_bin_offsets[tid * NUM_BINS + Bin(csr_matrix.row_offsets[row + 1] - csr_matrix.row_offsets[row])]++] = row;
+        }
+
+        OffsetT num_long_rows   = BinRows(BIN_LONG);
+        long_row_end_offsets    = new OffsetT[num_long_rows];
+
+        OffsetT running_nonzeros = 0;
+        for (OffsetT i = 0; i < num_long_rows; ++i)
+        {
+            OffsetT row = rows[bin_offsets[BIN_LONG] + i];
+            running_nonzeros += csr_matrix.row_offsets[row + 1] - csr_matrix.row_offsets[row];
+            long_row_end_offsets[i] = running_nonzeros;
+        }
+    }
+
+
+    OffsetT BinRows(int bin)
+    {
+        return bin_offsets[bin + 1] - bin_offsets[bin];
+    }
+
+
+    template <typename ValueT>
+    RowBins(
+        CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+        int                         num_threads)
+    {
+        Init(csr_matrix, num_threads);
+    }
+
+
+    ~RowBins()
+    {
+        if (rows)                   delete[] rows;
+        if (long_row_end_offsets)   delete[] long_row_end_offsets;
+    }
+};
+
+
+/**
+ * SpMV over a bin of rows no longer than MAX_LENGTH.  Rows are taken a
+ * cache line's worth of values at a time (8 fp64 or 16 fp32), one row per
+ * SIMD lane: the fully unrolled nonzero loop issues one masked gather of
+ * column indices, values and x across the whole group per step, so several
+ * short rows are in flight at once.
+ */
+template <
+    int         MAX_LENGTH,
+    typename    ValueT,
+    typename    OffsetT>
+void OmpShortRowsCsrmv(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict          rows,
+    OffsetT                         num_rows,
+    ValueT*     __restrict          vector_x,
+    ValueT*     __restrict          vector_y_out)
+{
+    const int GROUP_ROWS = 64 / sizeof(ValueT);
+
+    const OffsetT*  __restrict  row_offsets     = a.row_offsets;
+    const OffsetT*  __restrict  column_indices  = a.column_indices;
+    const ValueT*   __restrict  values          = a.values;
+
+    OffsetT num_groups = (num_rows + GROUP_ROWS - 1) / GROUP_ROWS;
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (OffsetT group = 0; group < num_groups; ++group)
+    {
+        OffsetT group_begin = group * GROUP_ROWS;
+        OffsetT group_rows  = std::min(OffsetT(GROUP_ROWS), num_rows - group_begin);
+
+        // Lanes past the end of the bin repeat the group's first row with
+        // length zero, so every lane's gathers stay in bounds
+        OffsetT row_begin[GROUP_ROWS];
+        OffsetT row_length[GROUP_ROWS];
+        ValueT  running_total[GROUP_ROWS];
+        for (int lane = 0; lane < GROUP_ROWS; ++lane)
+        {
+            OffsetT row         = rows[group_begin + ((lane < group_rows) ? lane : 0)];
+            row_begin[lane]     = row_offsets[row];
+            row_length[lane]    = (lane < group_rows) ? row_offsets[row + 1] - row_begin[lane] : 0;
+            running_total[lane] = 0.0;
+        }
+
+        for (int nz = 0; nz < MAX_LENGTH; ++nz)
+        {
+            #pragma omp simd
+            for (int lane = 0; lane < GROUP_ROWS; ++lane)
+            {
+                bool    active  = (nz < row_length[lane]);
+                OffsetT offset  = row_begin[lane] + (active ? nz : 0);
+                ValueT  product = values[offset] * vector_x[column_indices[offset]];
+                running_total[lane] += active ? product : ValueT(0);
+            }
+        }
+
+        for (int lane = 0; lane < group_rows; ++lane)
+            vector_y_out[rows[group_begin + lane]] = running_total[lane];
+    }
+}
+
+
+/**
+ * SpMV over a bin of medium-length rows, one SIMD dot product per row
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMediumRowsCsrmv(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict          rows,
+    OffsetT                         num_rows,
+    ValueT*     __restrict          vector_x,
+    ValueT*     __restrict          vector_y_out)
+{
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (OffsetT i = 0; i < num_rows; ++i)
+    {
+        OffsetT row             = rows[i];
+        ValueT  running_total   = 0.0;
+
+        #pragma omp simd reduction(+:running_total)
+        for (OffsetT nz = a.row_offsets[row]; nz < a.row_offsets[row + 1]; ++nz)
+        {
+            running_total += a.values[nz] * vector_x[a.column_indices[nz]];
+        }
+
+        vector_y_out[row] = running_total;
+    }
+}
+
+
+/**
+ * SpMV over the long-row bin, merge-path split over the bin's running
+ * nonzero count so that single rows can span threads
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpLongRowsCsrmv(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT*    __restrict          rows,
+    OffsetT*    __restrict          row_end_offsets,    ///< Merge list A (running nonzero count over the bin)
+    OffsetT                         num_rows,
+    ValueT*     __restrict          vector_x,
+    ValueT*     __restrict          vector_y_out)
+{
+    if (num_rows == 0)
+        return;
+
+    // Temporary storage for inter-thread fix-up after load-balanced work
+    OffsetT     row_carry_out[256];     // The last bin row each worked on by each thread when it finished its path segment
+    ValueT      value_carry_out[256];   // The running total within each thread when it finished its path segment
+
+    OffsetT     num_nonzeros = row_end_offsets[num_rows - 1];
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+        // Merge list B (NZ indices within the bin)
+        CountingInputIterator<OffsetT>  nonzero_indices(0);
+
+        OffsetT num_merge_items     = num_rows + num_nonzeros;                              // Merge path total length
+        OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;    // Merge items per thread
+
+        // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
+        int2    thread_coord;
+        int2    thread_coord_end;
+        int     start_diagonal      = std::min(items_per_thread * tid, num_merge_items);
+        int     end_diagonal        = std::min(start_diagonal + items_per_thread, num_merge_items);
+
+        MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, num_rows, num_nonzeros, thread_coord);
+        MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, num_rows, num_nonzeros, thread_coord_end);
+
+        // Consume whole rows
+        for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+        {
+            // Translate bin nonzero indices into matrix nonzero indices
+            OffsetT row             = rows[thread_coord.x];
+            OffsetT bin_to_matrix   = a.row_offsets[row + 1] - row_end_offsets[thread_coord.x];
+            ValueT  running_total   = 0.0;
+
+            #pragma omp simd reduction(+:running_total)
+            for (OffsetT nz = thread_coord.y + bin_to_matrix; nz < a.row_offsets[row + 1]; ++nz)
+            {
+                running_total += a.values[nz] * vector_x[a.column_indices[nz]];
+            }
+
+            thread_coord.y = row_end_offsets[thread_coord.x];
+            vector_y_out[row] = running_total;
+        }
+
+        // Consume partial portion of thread's last row
+        ValueT running_total = 0.0;
+        if (thread_coord.y < thread_coord_end.y)
+        {
+            OffsetT row             = rows[thread_coord.x];
+            OffsetT bin_to_matrix   = a.row_offsets[row + 1] - row_end_offsets[thread_coord.x];
+
+            #pragma omp simd reduction(+:running_total)
+            for (OffsetT nz = thread_coord.y + bin_to_matrix; nz < thread_coord_end.y + bin_to_matrix; ++nz)
+            {
+                running_total += a.values[nz] * vector_x[a.column_indices[nz]];
+            }
+        }
+
+        // Save carry-outs
+        row_carry_out[tid] = thread_coord_end.x;
+        value_carry_out[tid] = running_total;
+    }
+
+    // Carry-out fix-up (rows spanning multiple threads)
+    for (int tid = 0; tid < num_threads - 1; ++tid)
+    {
+        if (row_carry_out[tid] < num_rows)
+            vector_y_out[rows[row_carry_out[tid]]] += value_carry_out[tid];
+    }
+}
+
+
+/**
+ * Row-binned SpMV: one specialized kernel per row-length bin
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpBinnedCsrmv(
+    int                             num_threads,
+    CsrMatrix<ValueT, OffsetT>&     a,
+    RowBins<OffsetT>&               bins,
+    ValueT*     __restrict          vector_x,
+    ValueT*     __restrict          vector_y_out)
+{
+    typedef RowBins<OffsetT> BinsT;
+
+    OffsetT* empty_rows = bins.rows + bins.bin_offsets[BinsT::BIN_EMPTY];
+    OffsetT  num_empty_rows = bins.BinRows(BinsT::BIN_EMPTY);
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (OffsetT i = 0; i < num_empty_rows; ++i)
+    {
+        vector_y_out[empty_rows[i]] = 0.0;
+    }
+
+    OmpShortRowsCsrmv<1>(num_threads, a, bins.rows + bins.bin_offsets[BinsT::BIN_1], bins.BinRows(BinsT::BIN_1), vector_x, vector_y_out);
+    OmpShortRowsCsrmv<4>(num_threads, a, bins.rows + bins.bin_offsets[BinsT::BIN_4], bins.BinRows(BinsT::BIN_4), vector_x, vector_y_out);
+    OmpMediumRowsCsrmv(num_threads, a, bins.rows + bins.bin_offsets[BinsT::BIN_16], bins.BinRows(BinsT::BIN_16), vector_x, vector_y_out);
+    OmpMediumRowsCsrmv(num_threads, a, bins.rows + bins.bin_offsets[BinsT::BIN_128], bins.BinRows(BinsT::BIN_128), vector_x, vector_y_out);
+    OmpLongRowsCsrmv(num_threads, a, bins.rows + bins.bin_offsets[BinsT::BIN_LONG], bins.long_row_end_offsets, bins.BinRows(BinsT::BIN_LONG), vector_x, vector_y_out);
+}
+
+
+/**
+ * Run OmpBinnedCsrmv.  Binning is reported as setup time.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+float TestBinnedCsrmv(
+    CsrMatrix<ValueT, OffsetT>&     a,
+    ValueT*                         vector_x,
+    ValueT*                         reference_vector_y_out,
+    ValueT*                         vector_y_out,
+    int                             timing_iterations,
+    float                           &setup_ms)
+{
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    CpuTimer setup_timer;
+    setup_timer.Start();
+    RowBins<OffsetT> bins(a, g_omp_threads);
+    setup_timer.Stop();
+    setup_ms = setup_timer.ElapsedMillis();
+
+    if (!g_quiet)
+    {
+        printf("\tUsing %d threads on %d procs, rows per bin (0, 1, 2-4, 5-16, 17-128, >128): %d %d %d %d %d %d\n",
+            g_omp_threads, omp_get_num_procs(),
+            (int) bins.BinRows(0), (int) bins.BinRows(1), (int) bins.BinRows(2),
+            (int) bins.BinRows(3), (int) bins.BinRows(4), (int) bins.BinRows(5));
+    }
+
+    // Warmup/correctness
+    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
+    OmpBinnedCsrmv(g_omp_threads, a, bins, vector_x, vector_y_out);
+    if (!g_quiet)
+    {
+        // Check answer
+        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
+        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
+    }
+
+    // Re-populate caches, etc.
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpBinnedCsrmv(g_omp_threads, a, bins, vector_x, vector_y_out);
+    }
+
+    // Timing
+    float elapsed_ms = 0.0;
+    CpuTimer timer;
+    timer.Start();
+    for(int it = 0; it < timing_iterations; ++it)
+    {
+        OmpBinnedCsrmv(g_omp_threads, a, bins, vector_x, vector_y_out);
+    }
+    timer.Stop();
+    elapsed_ms += timer.ElapsedMillis();
+
+    return elapsed_ms / timing_iterations;
+}
+
+
+//---------------------------------------------------------------------
+// Column-panel merge-based SpMV
+//---------------------------------------------------------------------
+
+/**
+ * OpenMP CPU merge-based SpMV over a column-panel CSR matrix.  Panels are
+ * processed one after another, each with its own merge-path decomposition over
+ * only the rows it intersects, so the slice of x being gathered stays resident
+ * in cache for the whole panel.  Partial row sums accumulate into y.
+ */
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpColumnPanelCsrmv(
+    int                                     num_threads,
+    ColumnPanelCsrMatrix<ValueT, OffsetT>&  a,
+    ValueT*     __restrict                  vector_x,
+    ValueT*     __restrict                  vector_y_out)
+{
+    // Temporary storage for inter-thread fix-up after load-balanced work
+    OffsetT     row_carry_out[256];     // The last compacted row each worked on by each thread when it finished its path segment
+    ValueT      value_carry_out[256];   // The running total within each thread when it finished its path segment
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (OffsetT row = 0; row < a.num_rows; ++row)
+    {
+        vector_y_out[row] = 0.0;
+    }
+
+    for (OffsetT panel = 0; panel < a.num_panels; ++panel)
+    {
+        OffsetT     num_panel_rows      = a.PanelRows(panel);
+        OffsetT     num_panel_nonzeros  = a.PanelNonzeros(panel);
+        OffsetT*    row_ids             = a.row_ids + a.panel_row_offsets[panel];
+        OffsetT*    row_end_offsets     = a.row_end_offsets + a.panel_row_offsets[panel];       ///< Merge list A (compacted row end-offsets)
+        OffsetT*    column_indices      = a.column_indices + a.panel_nonzero_offsets[panel];
+        ValueT*     values              = a.values + a.panel_nonzero_offsets[panel];
+
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (int tid = 0; tid < num_threads; tid++)
+        {
+            // Merge list B (NZ indices)
+            CountingInputIterator<OffsetT>  nonzero_indices(0);
+
+            OffsetT num_merge_items     = num_panel_rows + num_panel_nonzeros;                  // Merge path total length
+            OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;    // Merge items per thread
+
+            // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
+            int2    thread_coord;
+            int2    thread_coord_end;
+            int     start_diagonal      = std::min(items_per_thread * tid, num_merge_items);
+            int     end_diagonal        = std::min(start_diagonal + items_per_thread, num_merge_items);
+
+            MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, num_panel_rows, num_panel_nonzeros, thread_coord);
+            MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, num_panel_rows, num_panel_nonzeros, thread_coord_end);
+
+            // Consume whole rows
+            for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
+            {
+                ValueT running_total = 0.0;
+                for (; thread_coord.y < row_end_offsets[thread_coord.x]; ++thread_coord.y)
+                {
+                    running_total += values[thread_coord.y] * vector_x[column_indices[thread_coord.y]];
+                }
+
+                vector_y_out[row_ids[thread_coord.x]] += running_total;
+            }
+
+            // Consume partial portion of thread's last row
+            ValueT running_total = 0.0;
+            for (; thread_coord.y < thread_coord_end.y; ++thread_coord.y)
+            {
+                running_total += values[thread_coord.y] * vector_x[column_indices[thread_coord.y]];
+            }
+
+            // Save carry-outs
+            row_carry_out[tid] = thread_coord_end.x;
+            value_carry_out[tid] = running_total;
+        }
+
+        // Carry-out fix-up (rows spanning multiple threads)
+        for (int tid = 0; tid < num_threads - 1; ++tid)
+        {
+            if (row_carry_out[tid] < num_panel_rows)
+                vector_y_out[row_ids[row_carry_out[tid]]] += value_carry_out[tid];
         }
-        vector_y_out[row] = partial;
     }
 }
 
 
 /**
- * Run OmpCsrSpmv
+ * Run OmpColumnPanelCsrmv.  Building the column-panel matrix is reported as
+ * setup time.
  */
 template <
     typename ValueT,
     typename OffsetT>
-float TestOmpCsrSpmv(
+float TestColumnPanelCsrmv(
     CsrMatrix<ValueT, OffsetT>&     a,
+    OffsetT                         panel_width,
     ValueT*                         vector_x,
     ValueT*                         reference_vector_y_out,
     ValueT*                         vector_y_out,
     int                             timing_iterations,
     float                           &setup_ms)
 {
-    setup_ms = 0.0;
-
     if (g_omp_threads == -1)
         g_omp_threads = omp_get_num_procs();
-    int num_threads = g_omp_threads;
+
+    CpuTimer setup_timer;
+    setup_timer.Start();
+    ColumnPanelCsrMatrix<ValueT, OffsetT> panel_matrix(a, panel_width, g_omp_threads);
+    setup_timer.Stop();
+    setup_ms = setup_timer.ElapsedMillis();
 
     if (!g_quiet)
-        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+    {
+        printf("\tUsing %d threads on %d procs, %d panels of %d columns, %d compacted rows (%.2fx rows)\n",
+            g_omp_threads, omp_get_num_procs(), (int) panel_matrix.num_panels, (int) panel_width,
+            (int) panel_matrix.panel_row_offsets[panel_matrix.num_panels],
+            double(panel_matrix.panel_row_offsets[panel_matrix.num_panels]) / a.num_rows);
+    }
 
     // Warmup/correctness
     memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
-    OmpCsrSpmv(g_omp_threads, a, vector_x, vector_y_out);
+    OmpColumnPanelCsrmv(g_omp_threads, panel_matrix, vector_x, vector_y_out);
     if (!g_quiet)
     {
         // Check answer
         int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
         printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
     }
- 
+
     // Re-populate caches, etc.
     for(int it = 0; it < timing_iterations; ++it)
     {
-        OmpCsrSpmv(g_omp_threads, a, vector_x, vector_y_out);
+        OmpColumnPanelCsrmv(g_omp_threads, panel_matrix, vector_x, vector_y_out);
     }
-    
+
     // Timing
     float elapsed_ms = 0.0;
     CpuTimer timer;
     timer.Start();
     for(int it = 0; it < timing_iterations; ++it)
     {
-        OmpCsrSpmv(g_omp_threads, a, vector_x, vector_y_out);
+        OmpColumnPanelCsrmv(g_omp_threads, panel_matrix, vector_x, vector_y_out);
     }
     timer.Stop();
     elapsed_ms += timer.ElapsedMillis();
@@ -360,38 +1454,64 @@ float TestOmpCsrSpmv(
 }
 
 
-
 //---------------------------------------------------------------------
-// CPU merge-based SpMV
+// Hypersparse (DCSR) merge-based SpMV
 //---------------------------------------------------------------------
 
+/**
+ * y[begin, end) = beta * y[begin, end), without reading y when beta is zero
+ */
+template <typename ValueT, typename OffsetT>
+inline void ScaleRows(
+    ValueT*     vector_y,
+    OffsetT     begin,
+    OffsetT     end,
+    ValueT      beta)
+{
+    if (beta == ValueT(0.0))
+    {
+        for (OffsetT row = begin; row < end; ++row)
+            vector_y[row] = 0.0;
+    }
+    else
+    {
+        for (OffsetT row = begin; row < end; ++row)
+            vector_y[row] *= beta;
+    }
+}
+
 
 /**
- * OpenMP CPU merge-based SpMV
+ * OpenMP CPU merge-based SpMV over a DCSR matrix: y = alpha * Ax + beta * y.
+ * The merge path only covers non-empty rows.  Each thread also handles the
+ * run of empty rows in front of every non-empty row it starts (the last
+ * thread also takes the trailing run), zero-filling them when beta is zero,
+ * skipping them when beta is one, and scaling them otherwise.
  */
 template <
     typename ValueT,
     typename OffsetT>
-void OmpMergeCsrmv(
+void OmpMergeDcsrmv(
     int                             num_threads,
-    CsrMatrix<ValueT, OffsetT>&     a,
-    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
-    OffsetT*    __restrict        column_indices,
-    ValueT*     __restrict        values,
-    ValueT*     __restrict        vector_x,
-    ValueT*     __restrict        vector_y_out)
+    DcsrMatrix<ValueT, OffsetT>&    a,
+    ValueT*     __restrict          vector_x,
+    ValueT*     __restrict          vector_y,
+    ValueT                          alpha,
+    ValueT                          beta)
 {
     // Temporary storage for inter-thread fix-up after load-balanced work
-    OffsetT     row_carry_out[256];     // The last row-id each worked on by each thread when it finished its path segment
+    OffsetT     row_carry_out[256];     // The last non-empty row each worked on by each thread when it finished its path segment
     ValueT      value_carry_out[256];   // The running total within each thread when it finished its path segment
 
+    OffsetT*    row_end_offsets = a.row_offsets + 1;    // Merge list A (non-empty row end-offsets)
+
     #pragma omp parallel for schedule(static) num_threads(num_threads)
     for (int tid = 0; tid < num_threads; tid++)
     {
         // Merge list B (NZ indices)
         CountingInputIterator<OffsetT>  nonzero_indices(0);
 
-        OffsetT num_merge_items     = a.num_rows + a.num_nonzeros;                          // Merge path total length
+        OffsetT num_merge_items     = a.num_nonempty_rows + a.num_nonzeros;                 // Merge path total length
         OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;    // Merge items per thread
 
         // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
@@ -400,8 +1520,18 @@ void OmpMergeCsrmv(
         int     start_diagonal      = std::min(items_per_thread * tid, num_merge_items);
         int     end_diagonal        = std::min(start_diagonal + items_per_thread, num_merge_items);
 
-        MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord);
-        MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, a.num_rows, a.num_nonzeros, thread_coord_end);
+        MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, a.num_nonempty_rows, a.num_nonzeros, thread_coord);
+        MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, a.num_nonempty_rows, a.num_nonzeros, thread_coord_end);
+
+        // Empty rows
+        if (beta != ValueT(1.0))
+        {
+            for (OffsetT i = thread_coord.x; i < thread_coord_end.x; ++i)
+                ScaleRows(vector_y, (i == 0) ? 0 : a.row_ids[i - 1] + 1, a.row_ids[i], beta);
+
+            if (tid == num_threads - 1)
+                ScaleRows(vector_y, (a.num_nonempty_rows == 0) ? 0 : a.row_ids[a.num_nonempty_rows - 1] + 1, a.num_rows, beta);
+        }
 
         // Consume whole rows
         for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
@@ -409,17 +1539,20 @@ void OmpMergeCsrmv(
             ValueT running_total = 0.0;
             for (; thread_coord.y < row_end_offsets[thread_coord.x]; ++thread_coord.y)
             {
-                running_total += values[thread_coord.y] * vector_x[column_indices[thread_coord.y]];
+                running_total += a.values[thread_coord.y] * vector_x[a.column_indices[thread_coord.y]];
             }
 
-            vector_y_out[thread_coord.x] = running_total;
+            OffsetT row = a.row_ids[thread_coord.x];
+            vector_y[row] = (beta == ValueT(0.0)) ?
+                alpha * running_total :
+                alpha * running_total + beta * vector_y[row];
         }
 
         // Consume partial portion of thread's last row
         ValueT running_total = 0.0;
         for (; thread_coord.y < thread_coord_end.y; ++thread_coord.y)
         {
-            running_total += values[thread_coord.y] * vector_x[column_indices[thread_coord.y]];
+            running_total += a.values[thread_coord.y] * vector_x[a.column_indices[thread_coord.y]];
         }
 
         // Save carry-outs
@@ -430,49 +1563,61 @@ void OmpMergeCsrmv(
     // Carry-out fix-up (rows spanning multiple threads)
     for (int tid = 0; tid < num_threads - 1; ++tid)
     {
-        if (row_carry_out[tid] < a.num_rows)
-            vector_y_out[row_carry_out[tid]] += value_carry_out[tid];
+        if (row_carry_out[tid] < a.num_nonempty_rows)
+            vector_y[a.row_ids[row_carry_out[tid]]] += alpha * value_carry_out[tid];
     }
 }
 
 
 /**
- * Run OmpMergeCsrmv
+ * Run OmpMergeDcsrmv.  y is updated in place from vector_y_in; building the
+ * DCSR matrix is reported as setup time.
  */
 template <
     typename ValueT,
     typename OffsetT>
-float TestOmpMergeCsrmv(
+float TestMergeDcsrmv(
     CsrMatrix<ValueT, OffsetT>&     a,
     ValueT*                         vector_x,
+    ValueT*                         vector_y_in,
     ValueT*                         reference_vector_y_out,
     ValueT*                         vector_y_out,
+    ValueT                          alpha,
+    ValueT                          beta,
     int                             timing_iterations,
     float                           &setup_ms)
 {
-    setup_ms = 0.0;
-
     if (g_omp_threads == -1)
         g_omp_threads = omp_get_num_procs();
-    int num_threads = g_omp_threads;
+
+    CpuTimer setup_timer;
+    setup_timer.Start();
+    DcsrMatrix<ValueT, OffsetT> dcsr_matrix(a);
+    setup_timer.Stop();
+    setup_ms = setup_timer.ElapsedMillis();
 
     if (!g_quiet)
-        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
+    {
+        printf("\tUsing %d threads on %d procs, %d of %d rows non-empty (%.2f%%), %d merge items saved\n",
+            g_omp_threads, omp_get_num_procs(), (int) dcsr_matrix.num_nonempty_rows, (int) a.num_rows,
+            double(dcsr_matrix.num_nonempty_rows) * 100.0 / a.num_rows,
+            (int) (a.num_rows - dcsr_matrix.num_nonempty_rows));
+    }
 
     // Warmup/correctness
-    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
-    OmpMergeCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    memcpy(vector_y_out, vector_y_in, sizeof(ValueT) * a.num_rows);
+    OmpMergeDcsrmv(g_omp_threads, dcsr_matrix, vector_x, vector_y_out, alpha, beta);
     if (!g_quiet)
     {
         // Check answer
         int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
         printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
     }
- 
+
     // Re-populate caches, etc.
     for(int it = 0; it < timing_iterations; ++it)
     {
-        OmpMergeCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+        OmpMergeDcsrmv(g_omp_threads, dcsr_matrix, vector_x, vector_y_out, alpha, beta);
     }
 
     // Timing
@@ -481,7 +1626,7 @@ float TestOmpMergeCsrmv(
     timer.Start();
     for(int it = 0; it < timing_iterations; ++it)
     {
-        OmpMergeCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+        OmpMergeDcsrmv(g_omp_threads, dcsr_matrix, vector_x, vector_y_out, alpha, beta);
     }
     timer.Stop();
     elapsed_ms += timer.ElapsedMillis();
@@ -489,47 +1634,35 @@ float TestOmpMergeCsrmv(
     return elapsed_ms / timing_iterations;
 }
 
-template <
-    typename AIteratorT,
-    typename BIteratorT,
-    typename OffsetT,
-    typename CoordinateT>
-inline void RowPathSearch(
-    AIteratorT      a,                  ///< [in]List A
-    BIteratorT      b,                  ///< [in]List B
-    OffsetT         a_len,              ///< [in]Length of A
-    CoordinateT&    path_coordinate)    ///< [out] (x,y) coordinate where diagonal intersects the merge path
-{
-    OffsetT x_min = 0;
-    OffsetT x_max = a_len;
-
-    while (x_min < x_max)
-    {
-        OffsetT x_pivot = (x_min + x_max) >> 1;
-        if (a[x_pivot] <= b[path_coordinate.y - 1])
-            x_min = x_pivot + 1;    // Contract range up A (down B)
-        else
-            x_max = x_pivot;        // Contract range down A (up B)
-    }
 
-    path_coordinate.x = std::min(x_min, a_len);
-}
+//---------------------------------------------------------------------
+// Hub-split merge-based SpMV
+//---------------------------------------------------------------------
 
 /**
- * OpenMP CPU row-based SpMM
+ * OpenMP CPU merge-based SpMV over a hub-split matrix.  The remainder goes
+ * through the merge path as in OmpMergeCsrmv, and every row finished there
+ * also takes its dot product with the hot-column block: each thread loads the
+ * HOT_WIDTH hub entries of x into locals once, so they stay in registers
+ * instead of being gathered again for every row.  The dense rows (empty in
+ * the remainder) are then one GEMV into dense_vector_y_out, scattered into y.
  */
 template <
-    typename ValueT,
-    typename OffsetT>
-void OmpNonzeroSplitCsrmm(
-    int                             num_threads,
-    CsrMatrix<ValueT, OffsetT>&     a,
-    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
-    OffsetT*    __restrict        column_indices,
-    ValueT*     __restrict        values,
-    ValueT*     __restrict        vector_x,
-    ValueT*     __restrict        vector_y_out)
+    int         HOT_WIDTH,
+    typename    ValueT,
+    typename    OffsetT>
+void OmpMergeHubSplitCsrmv(
+    int                                 num_threads,
+    HubSplitCsrMatrix<ValueT, OffsetT>& a,
+    ValueT*     __restrict              vector_x,
+    ValueT*     __restrict              vector_y_out,
+    ValueT*     __restrict              dense_vector_y_out)     ///< Dense-row results (num_dense_rows)
 {
+    CsrMatrix<ValueT, OffsetT>  &remainder      = *a.remainder;
+    OffsetT*                    row_end_offsets = remainder.row_offsets + 1;    ///< Merge list A (row end-offsets)
+    OffsetT*                    column_indices  = remainder.column_indices;
+    ValueT*                     values          = remainder.values;
+
     // Temporary storage for inter-thread fix-up after load-balanced work
     OffsetT     row_carry_out[256];     // The last row-id each worked on by each thread when it finished its path segment
     ValueT      value_carry_out[256];   // The running total within each thread when it finished its path segment
@@ -537,25 +1670,35 @@ void OmpNonzeroSplitCsrmm(
     #pragma omp parallel for schedule(static) num_threads(num_threads)
     for (int tid = 0; tid < num_threads; tid++)
     {
+        // Hub entries of x
+        ValueT x_hot[(HOT_WIDTH > 0) ? HOT_WIDTH : 1];
+        for (int h = 0; h < HOT_WIDTH; ++h)
+            x_hot[h] = vector_x[a.hot_columns[h]];
+
         // Merge list B (NZ indices)
         CountingInputIterator<OffsetT>  nonzero_indices(0);
 
-        OffsetT num_nonzeros     = a.num_nonzeros;                          
-        OffsetT items_per_thread    = (num_nonzeros + num_threads - 1) / num_threads;
+        OffsetT num_merge_items     = remainder.num_rows + remainder.num_nonzeros;          // Merge path total length
+        OffsetT items_per_thread    = (num_merge_items + num_threads - 1) / num_threads;    // Merge items per thread
 
         // Find starting and ending MergePath coordinates (row-idx, nonzero-idx) for each thread
         int2    thread_coord;
         int2    thread_coord_end;
-        thread_coord.y            = std::min(items_per_thread * tid, num_nonzeros);
-        thread_coord_end.y        = std::min(thread_coord.y + items_per_thread, num_nonzeros);
+        int     start_diagonal      = std::min(items_per_thread * tid, num_merge_items);
+        int     end_diagonal        = std::min(start_diagonal + items_per_thread, num_merge_items);
 
-        RowPathSearch(row_end_offsets, nonzero_indices, a.num_rows, thread_coord);
-        RowPathSearch(row_end_offsets, nonzero_indices, a.num_rows, thread_coord_end);
+        MergePathSearch(start_diagonal, row_end_offsets, nonzero_indices, remainder.num_rows, remainder.num_nonzeros, thread_coord);
+        MergePathSearch(end_diagonal, row_end_offsets, nonzero_indices, remainder.num_rows, remainder.num_nonzeros, thread_coord_end);
 
-                // Consume whole rows
+        // Consume whole rows
         for (; thread_coord.x < thread_coord_end.x; ++thread_coord.x)
         {
             ValueT running_total = 0.0;
+
+            const ValueT* hot_values = a.hot_values + size_t(thread_coord.x) * HOT_WIDTH;
+            for (int h = 0; h < HOT_WIDTH; ++h)
+                running_total += hot_values[h] * x_hot[h];
+
             for (; thread_coord.y < row_end_offsets[thread_coord.x]; ++thread_coord.y)
             {
                 running_total += values[thread_coord.y] * vector_x[column_indices[thread_coord.y]];
@@ -579,130 +1722,101 @@ void OmpNonzeroSplitCsrmm(
     // Carry-out fix-up (rows spanning multiple threads)
     for (int tid = 0; tid < num_threads - 1; ++tid)
     {
-        if (row_carry_out[tid] < a.num_rows)
+        if (row_carry_out[tid] < remainder.num_rows)
             vector_y_out[row_carry_out[tid]] += value_carry_out[tid];
     }
-}
-
-template <
-    typename ValueT,
-    typename OffsetT>
-float TestOmpNonzeroSplitCsrmm(
-    CsrMatrix<ValueT, OffsetT>&     a,
-    ValueT*                         vector_x,
-    ValueT*                         reference_vector_y_out,
-    ValueT*                         vector_y_out,
-    int                             timing_iterations,
-    float                           &setup_ms)
-{
-    setup_ms = 0.0;
-
-    if (g_omp_threads == -1)
-        g_omp_threads = omp_get_num_procs();
-    int num_threads = g_omp_threads;
-
-    if (!g_quiet)
-        printf("\tUsing %d threads on %d procs\n", g_omp_threads, omp_get_num_procs());
-
-    // Warmup/correctness
-    memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
-    OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
-    if (!g_quiet)
-    {
-        // Check answer
-        int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
-        printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
-    }
-    
-    // Re-populate caches, etc.
-    for(int it = 0; it < timing_iterations; ++it)
-    {
-        OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
-    }
 
-    // Timing
-    float elapsed_ms = 0.0;
-    CpuTimer timer;
-    timer.Start();
-    for(int it = 0; it < timing_iterations; ++it)
+    // Dense rows
+    if (a.num_dense_rows > 0)
     {
-        OmpNonzeroSplitCsrmm(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+        DenseGemv(a.num_dense_rows, a.num_cols, a.dense_values, vector_x, dense_vector_y_out);
+        for (OffsetT i = 0; i < a.num_dense_rows; ++i)
+            vector_y_out[a.dense_rows[i]] = dense_vector_y_out[i];
     }
-    timer.Stop();
-    elapsed_ms += timer.ElapsedMillis();
-
-    return elapsed_ms / timing_iterations;
 }
 
-//---------------------------------------------------------------------
-// MKL SpMV
-//---------------------------------------------------------------------
-
-/**
- * MKL CPU SpMV (specialized for fp32)
- */
-template <typename OffsetT>
-void MklCsrmv(
-    int                           num_threads,
-    CsrMatrix<float, OffsetT>&    a,
-    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
-    OffsetT*    __restrict        column_indices,
-    float*      __restrict        values,
-    float*      __restrict        vector_x,
-    float*      __restrict        vector_y_out)
-{
-    mkl_cspblas_scsrgemv("n", &a.num_rows, a.values, a.row_offsets, a.column_indices, vector_x, vector_y_out);
-}
 
 /**
- * MKL CPU SpMV (specialized for fp64)
+ * OpenMP CPU merge-based SpMV over a hub-split matrix (dispatches on the
+ * hot-column block width)
  */
-template <typename OffsetT>
-void MklCsrmv(
-    int                           num_threads,
-    CsrMatrix<double, OffsetT>&   a,
-    OffsetT*    __restrict        row_end_offsets,    ///< Merge list A (row end-offsets)
-    OffsetT*    __restrict        column_indices,
-    double*     __restrict        values,
-    double*     __restrict        vector_x,
-    double*     __restrict        vector_y_out)
+template <
+    typename ValueT,
+    typename OffsetT>
+void OmpMergeHubSplitCsrmv(
+    int                                 num_threads,
+    HubSplitCsrMatrix<ValueT, OffsetT>& a,
+    ValueT*     __restrict              vector_x,
+    ValueT*     __restrict              vector_y_out,
+    ValueT*     __restrict              dense_vector_y_out)     ///< Dense-row results (num_dense_rows)
 {
-    mkl_cspblas_dcsrgemv("n", &a.num_rows, a.values, a.row_offsets, a.column_indices, vector_x, vector_y_out);
+    switch (a.hot_width)
+    {
+        case 0: OmpMergeHubSplitCsrmv<0>(num_threads, a, vector_x, vector_y_out, dense_vector_y_out); break;
+        case 1: OmpMergeHubSplitCsrmv<1>(num_threads, a, vector_x, vector_y_out, dense_vector_y_out); break;
+        case 2: OmpMergeHubSplitCsrmv<2>(num_threads, a, vector_x, vector_y_out, dense_vector_y_out); break;
+        case 4: OmpMergeHubSplitCsrmv<4>(num_threads, a, vector_x, vector_y_out, dense_vector_y_out); break;
+        default: OmpMergeHubSplitCsrmv<8>(num_threads, a, vector_x, vector_y_out, dense_vector_y_out); break;
+    }
 }
 
 
 /**
- * Run MKL CsrMV
+ * Run OmpMergeHubSplitCsrmv.  Splitting the matrix is reported as setup time.
  */
 template <
     typename ValueT,
     typename OffsetT>
-float TestMklCsrmv(
+float TestMergeHubSplitCsrmv(
     CsrMatrix<ValueT, OffsetT>&     a,
+    double                          density,
     ValueT*                         vector_x,
     ValueT*                         reference_vector_y_out,
     ValueT*                         vector_y_out,
     int                             timing_iterations,
     float                           &setup_ms)
 {
-    setup_ms = 0.0;
+    if (g_omp_threads == -1)
+        g_omp_threads = omp_get_num_procs();
+
+    CpuTimer setup_timer;
+    setup_timer.Start();
+    HubSplitCsrMatrix<ValueT, OffsetT> split_matrix(a, density, g_omp_threads);
+    setup_timer.Stop();
+    setup_ms = setup_timer.ElapsedMillis();
+
+    if (!g_quiet)
+    {
+        OffsetT longest_row = 0, longest_remainder_row = 0;
+        for (OffsetT row = 0; row < a.num_rows; ++row)
+        {
+            longest_row             = std::max(longest_row, a.row_offsets[row + 1] - a.row_offsets[row]);
+            longest_remainder_row   = std::max(longest_remainder_row, split_matrix.remainder->row_offsets[row + 1] - split_matrix.remainder->row_offsets[row]);
+        }
+
+        printf("\tUsing %d threads on %d procs, density >= %g\n", g_omp_threads, omp_get_num_procs(), density);
+        printf("\t%d dense rows (%d nonzeros), %d hot columns (%d nonzeros, block width %d), %d remainder nonzeros, longest row %d -> %d\n",
+            (int) split_matrix.num_dense_rows, (int) split_matrix.dense_row_nonzeros,
+            (int) split_matrix.num_hot_columns, (int) split_matrix.hot_nonzeros, split_matrix.hot_width,
+            (int) split_matrix.remainder->num_nonzeros, (int) longest_row, (int) longest_remainder_row);
+    }
+
+    ValueT* dense_vector_y_out = (ValueT*) mkl_malloc(sizeof(ValueT) * std::max(split_matrix.num_dense_rows, OffsetT(1)), 4096);
 
     // Warmup/correctness
     memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
-    MklCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+    OmpMergeHubSplitCsrmv(g_omp_threads, split_matrix, vector_x, vector_y_out, dense_vector_y_out);
     if (!g_quiet)
     {
         // Check answer
         int compare = CompareResults(reference_vector_y_out, vector_y_out, a.num_rows, true);
         printf("\t%s\n", compare ? "FAIL" : "PASS"); fflush(stdout);
-
-        // memset(vector_y_out, -1, sizeof(ValueT) * a.num_rows);
     }
 
     // Re-populate caches, etc.
     for(int it = 0; it < timing_iterations; ++it)
     {
-        MklCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+        OmpMergeHubSplitCsrmv(g_omp_threads, split_matrix, vector_x, vector_y_out, dense_vector_y_out);
     }
 
     // Timing
@@ -711,11 +1825,13 @@ float TestMklCsrmv(
     timer.Start();
     for(int it = 0; it < timing_iterations; ++it)
     {
-        MklCsrmv(g_omp_threads, a, a.row_offsets + 1, a.column_indices, a.values, vector_x, vector_y_out);
+        OmpMergeHubSplitCsrmv(g_omp_threads, split_matrix, vector_x, vector_y_out, dense_vector_y_out);
     }
     timer.Stop();
     elapsed_ms += timer.ElapsedMillis();
 
+    mkl_free(dense_vector_y_out);
+
     return elapsed_ms / timing_iterations;
 }
 
@@ -804,7 +1920,7 @@ void RunTests(
     else if (wheel > 0)
     {
         // Generate wheel graph
-        printf("wheel_%d, ", grid2d); fflush(stdout);
+        printf("wheel_%d, ", wheel); fflush(stdout);
         coo_matrix.InitWheel(wheel);
     }
     else if (dense > 0)
@@ -896,6 +2012,70 @@ void RunTests(
     avg_ms = TestMklCsrmv(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms);
     DisplayPerf(setup_ms, avg_ms, csr_matrix);
 
+    // Row-binned SpMV
+    if (!g_quiet) printf("\n\n");
+    printf("Binned CsrMV, "); fflush(stdout);
+    avg_ms = TestBinnedCsrmv(csr_matrix, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms);
+    DisplayPerf(setup_ms, avg_ms, csr_matrix);
+
+    // Column-panel merge SpMV (half of the LLC holds the panel's slice of x)
+    OffsetT panel_width = OffsetT(std::max(size_t(1), g_llc_bytes / 2 / sizeof(ValueT)));
+    if (!g_quiet) printf("\n\n");
+    printf("Column-panel Merge CsrMV, "); fflush(stdout);
+    avg_ms = TestColumnPanelCsrmv(csr_matrix, panel_width, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms);
+    DisplayPerf(setup_ms, avg_ms, csr_matrix);
+
+    // Hypersparse merge SpMV
+    if (!g_quiet) printf("\n\n");
+    printf("DCSR Merge CsrMV, "); fflush(stdout);
+    avg_ms = TestMergeDcsrmv(csr_matrix, vector_x, vector_y_in, reference_vector_y_out, vector_y_out, alpha, beta, timing_iterations, setup_ms);
+    DisplayPerf(setup_ms, avg_ms, csr_matrix);
+
+    // Hub-split merge SpMV: dense rows and hot columns on dense paths
+    if (args.CheckCmdLineFlag("hub_split"))
+    {
+        double density = 0.5;
+        args.GetCmdLineArgument("hub_split", density);
+
+        if (!g_quiet) printf("\n\n");
+        printf("Hub-split Merge CsrMV, "); fflush(stdout);
+        avg_ms = TestMergeHubSplitCsrmv(csr_matrix, density, vector_x, reference_vector_y_out, vector_y_out, timing_iterations, setup_ms);
+        DisplayPerf(setup_ms, avg_ms, csr_matrix);
+    }
+
+    // Reordered merge SpMV (symmetric permutation requires a square matrix)
+    std::vector<std::string> reorderings;
+    args.GetCmdLineArguments("reorder", reorderings);
+    if (args.CheckCmdLineFlag("rcm"))
+        reorderings.push_back("rcm");
+
+    if (!reorderings.empty() && (csr_matrix.num_rows == csr_matrix.num_cols))
+    {
+        // x varies by column so that the check covers the x permutation
+        ValueT* reordered_vector_x              = (ValueT*) mkl_malloc(sizeof(ValueT) * csr_matrix.num_cols, 4096);
+        ValueT* reordered_reference_vector_y    = (ValueT*) mkl_malloc(sizeof(ValueT) * csr_matrix.num_rows, 4096);
+
+        for (int col = 0; col < csr_matrix.num_cols; ++col)
+            reordered_vector_x[col] = 1.0 + (col % 17);
+
+        SpmvGold(csr_matrix, reordered_vector_x, vector_y_in, reordered_reference_vector_y, alpha, beta);
+
+        for (int i = 0; i < int(reorderings.size()); ++i)
+        {
+            if (!g_quiet) printf("\n\n");
+            printf("%s Merge CsrMV, ", reorderings[i].c_str()); fflush(stdout);
+            avg_ms = TestReorderedMergeCsrmv(reorderings[i], csr_matrix, reordered_vector_x, reordered_reference_vector_y, vector_y_out, timing_iterations, setup_ms);
+            DisplayPerf(setup_ms, avg_ms, csr_matrix);
+        }
+
+        mkl_free(reordered_vector_x);
+        mkl_free(reordered_reference_vector_y);
+    }
+    else if (!reorderings.empty() && !g_quiet)
+    {
+        printf("\n\nReordered Merge CsrMV skipped (matrix is not square)\n");
+    }
+
     // Cleanup
     if (csr_matrix.IsNumaMalloc())
     {
@@ -934,6 +2114,10 @@ int main(int argc, char **argv)
             "[--fp64 (default) | --fp32] "
             "[--alpha=<alpha scalar (default: 1.0)>] "
             "[--beta=<beta scalar (default: 0.0)>] "
+            "[--rcm (alias for --reorder=rcm)] "
+            "[--reorder=<rcm,degree,hub,rabbit>] "
+            "[--llc_kb=<last-level cache size for column panels (default: detected)>] "
+            "[--hub_split=<density: rows/columns at least this dense go to dense paths (default: 0.5)>] "
             "\n\t"
                 "--mtx=<matrix market file> "
             "\n\t"
@@ -966,11 +2150,22 @@ int main(int argc, char **argv)
     args.GetCmdLineArgument("mtx", mtx_filename);
     args.GetCmdLineArgument("grid2d", grid2d);
     args.GetCmdLineArgument("grid3d", grid3d);
+    args.GetCmdLineArgument("wheel", wheel);
     args.GetCmdLineArgument("dense", dense);
     args.GetCmdLineArgument("alpha", alpha);
     args.GetCmdLineArgument("beta", beta);
     args.GetCmdLineArgument("threads", g_omp_threads);
 
+    long llc_bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc_bytes > 0)
+        g_llc_bytes = llc_bytes;
+    if (args.CheckCmdLineFlag("llc_kb"))
+    {
+        int llc_kb;
+        args.GetCmdLineArgument("llc_kb", llc_kb);
+        g_llc_bytes = size_t(llc_kb) << 10;
+    }
+
     // Run test(s)
     if (fp32)
     {
@@ -0,0 +1,806 @@
+/******************************************************************************
+ * Copyright (c) 2011-2015, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ * Matrix reordering.  Each pass produces a relabel vector (old id -> new id)
+ * that can be applied with CooMatrix::InitCsrRelabel.
+ ******************************************************************************/
+
+#pragma once
+
+#include <omp.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "sparse_matrix.h"
+
+
+/******************************************************************************
+ * Utilities
+ ******************************************************************************/
+
+/**
+ * Atomically lowers *addr to val if val is smaller
+ */
+template <typename T>
+inline void AtomicMin(T *addr, T val)
+{
+    T old = *addr;
+    while (val < old)
+    {
+        T prev = __sync_val_compare_and_swap(addr, old, val);
+        if (prev == old)
+            break;
+        old = prev;
+    }
+}
+
+
+/**
+ * Scatters a vector into relabeled order: dst[relabel_indices[i]] = src[i]
+ */
+template <typename ValueT, typename OffsetT>
+void PermuteVector(
+    ValueT*     dst,
+    ValueT*     src,
+    OffsetT*    relabel_indices,
+    OffsetT     len,
+    int         num_threads)
+{
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (OffsetT i = 0; i < len; ++i)
+        dst[relabel_indices[i]] = src[i];
+}
+
+
+/**
+ * Gathers a relabeled vector back into original order: dst[i] = src[relabel_indices[i]]
+ */
+template <typename ValueT, typename OffsetT>
+void UnpermuteVector(
+    ValueT*     dst,
+    ValueT*     src,
+    OffsetT*    relabel_indices,
+    OffsetT     len,
+    int         num_threads)
+{
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (OffsetT i = 0; i < len; ++i)
+        dst[i] = src[relabel_indices[i]];
+}
+
+
+/**
+ * Gathers the rows of a num_rows x num_vectors matrix with relabeled rows back
+ * into original order: row i of dst = row relabel_indices[i] of src, both in
+ * the given layout
+ */
+template <typename ValueT, typename OffsetT>
+void UnpermuteRows(
+    ValueT*     dst,
+    ValueT*     src,
+    OffsetT*    relabel_indices,
+    OffsetT     num_rows,
+    int         num_vectors,
+    bool        row_major,
+    int         num_threads)
+{
+    if (row_major)
+    {
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (OffsetT i = 0; i < num_rows; ++i)
+            std::copy(src + size_t(relabel_indices[i]) * num_vectors, src + size_t(relabel_indices[i] + 1) * num_vectors, dst + size_t(i) * num_vectors);
+    }
+    else
+    {
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (int k = 0; k < num_vectors; ++k)
+            for (OffsetT i = 0; i < num_rows; ++i)
+                dst[size_t(k) * num_rows + i] = src[size_t(k) * num_rows + relabel_indices[i]];
+    }
+}
+
+
+/******************************************************************************
+ * Symmetrized adjacency
+ ******************************************************************************/
+
+/**
+ * Undirected graph of a square matrix: the sparsity pattern of A + A^T with
+ * self-loops removed.  Neighbor lists are sorted and duplicate-free.
+ */
+template <typename OffsetT>
+struct SymmetricAdjacency
+{
+    OffsetT                 num_vertices;
+    std::vector<OffsetT>    offsets;
+    std::vector<OffsetT>    neighbors;
+
+    /**
+     * Builds the adjacency from a CSR matrix
+     */
+    template <typename CsrMatrixT>
+    void Init(CsrMatrixT &csr_matrix, int num_threads)
+    {
+        num_vertices = csr_matrix.num_rows;
+
+        // Count both directions of every off-diagonal nonzero
+        std::vector<OffsetT> counts(num_vertices + 1, 0);
+
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (OffsetT row = 0; row < num_vertices; ++row)
+        {
+            for (OffsetT nz = csr_matrix.row_offsets[row]; nz < csr_matrix.row_offsets[row + 1]; ++nz)
+            {
+                OffsetT col = csr_matrix.column_indices[nz];
+                if (col == row)
+                    continue;
+                __sync_fetch_and_add(&counts[row], 1);
+                __sync_fetch_and_add(&counts[col], 1);
+            }
+        }
+
+        std::vector<OffsetT> cursor(num_vertices + 1, 0);
+        for (OffsetT v = 0; v < num_vertices; ++v)
+            cursor[v + 1] = cursor[v] + counts[v];
+
+        std::vector<OffsetT> raw_offsets(cursor);
+        std::vector<OffsetT> raw_neighbors(cursor[num_vertices]);
+
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (OffsetT row = 0; row < num_vertices; ++row)
+        {
+            for (OffsetT nz = csr_matrix.row_offsets[row]; nz < csr_matrix.row_offsets[row + 1]; ++nz)
+            {
+                OffsetT col = csr_matrix.column_indices[nz];
+                if (col == row)
+                    continue;
+                raw_neighbors[__sync_fetch_and_add(&cursor[row], 1)] = col;
+                raw_neighbors[__sync_fetch_and_add(&cursor[col], 1)] = row;
+            }
+        }
+
+        // Sort and deduplicate each list (symmetric inputs produce every edge twice)
+        #pragma omp parallel for schedule(dynamic, 256) num_threads(num_threads)
+        for (OffsetT v = 0; v < num_vertices; ++v)
+        {
+            typename std::vector<OffsetT>::iterator begin   = raw_neighbors.begin() + raw_offsets[v];
+            typename std::vector<OffsetT>::iterator end     = raw_neighbors.begin() + raw_offsets[v + 1];
+            std::sort(begin, end);
+            counts[v] = OffsetT(std::unique(begin, end) - begin);
+        }
+
+        offsets.assign(num_vertices + 1, 0);
+        for (OffsetT v = 0; v < num_vertices; ++v)
+            offsets[v + 1] = offsets[v] + counts[v];
+
+        neighbors.resize(offsets[num_vertices]);
+
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (OffsetT v = 0; v < num_vertices; ++v)
+        {
+            std::copy(
+                raw_neighbors.begin() + raw_offsets[v],
+                raw_neighbors.begin() + raw_offsets[v] + counts[v],
+                neighbors.begin() + offsets[v]);
+        }
+    }
+
+    OffsetT Degree(OffsetT v) const
+    {
+        return offsets[v + 1] - offsets[v];
+    }
+};
+
+
+/******************************************************************************
+ * Reverse Cuthill-McKee
+ ******************************************************************************/
+
+/**
+ * BFS from root.  Returns the eccentricity of root and sets far_vertex to the
+ * minimum-degree vertex of the last level.  depth must be all -1 on entry and
+ * is restored on exit.
+ */
+template <typename OffsetT>
+OffsetT BfsEccentricity(
+    SymmetricAdjacency<OffsetT>     &adj,
+    OffsetT                         root,
+    std::vector<OffsetT>            &depth,
+    std::vector<OffsetT>            &queue,
+    OffsetT                         &far_vertex)
+{
+    queue.clear();
+    queue.push_back(root);
+    depth[root] = 0;
+
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        OffsetT u = queue[head];
+        for (OffsetT i = adj.offsets[u]; i < adj.offsets[u + 1]; ++i)
+        {
+            OffsetT v = adj.neighbors[i];
+            if (depth[v] < 0)
+            {
+                depth[v] = depth[u] + 1;
+                queue.push_back(v);
+            }
+        }
+    }
+
+    OffsetT eccentricity = depth[queue.back()];
+    far_vertex = queue.back();
+    for (size_t i = queue.size(); (i > 0) && (depth[queue[i - 1]] == eccentricity); --i)
+    {
+        if (adj.Degree(queue[i - 1]) < adj.Degree(far_vertex))
+            far_vertex = queue[i - 1];
+    }
+
+    for (size_t i = 0; i < queue.size(); ++i)
+        depth[queue[i]] = -1;
+
+    return eccentricity;
+}
+
+
+/**
+ * Finds a pseudo-peripheral vertex in the component of root (George-Liu)
+ */
+template <typename OffsetT>
+OffsetT PseudoPeripheralVertex(
+    SymmetricAdjacency<OffsetT>     &adj,
+    OffsetT                         root,
+    std::vector<OffsetT>            &depth,
+    std::vector<OffsetT>            &queue)
+{
+    OffsetT candidate;
+    OffsetT eccentricity = BfsEccentricity(adj, root, depth, queue, candidate);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        OffsetT next_candidate;
+        OffsetT next_eccentricity = BfsEccentricity(adj, candidate, depth, queue, next_candidate);
+        if (next_eccentricity <= eccentricity)
+            break;
+
+        root            = candidate;
+        eccentricity    = next_eccentricity;
+        candidate       = next_candidate;
+    }
+
+    return root;
+}
+
+
+/**
+ * Orders a BFS level by (parent label, degree, vertex id)
+ */
+template <typename OffsetT>
+struct CuthillMcKeeComparator
+{
+    const OffsetT*                  parent;
+    SymmetricAdjacency<OffsetT>*    adj;
+
+    CuthillMcKeeComparator(const OffsetT* parent, SymmetricAdjacency<OffsetT>* adj) : parent(parent), adj(adj) {}
+
+    bool operator()(OffsetT a, OffsetT b) const
+    {
+        if (parent[a] != parent[b])
+            return (parent[a] < parent[b]);
+        if (adj->Degree(a) != adj->Degree(b))
+            return (adj->Degree(a) < adj->Degree(b));
+        return (a < b);
+    }
+};
+
+
+/**
+ * Orders vertices by increasing degree
+ */
+template <typename OffsetT>
+struct DegreeComparator
+{
+    SymmetricAdjacency<OffsetT>*    adj;
+
+    DegreeComparator(SymmetricAdjacency<OffsetT>* adj) : adj(adj) {}
+
+    bool operator()(OffsetT a, OffsetT b) const
+    {
+        return (adj->Degree(a) < adj->Degree(b));
+    }
+};
+
+
+/**
+ * Computes a reverse Cuthill-McKee relabeling (relabel_indices[old] = new) of a
+ * square matrix.
+ *
+ * BFS levels are expanded in parallel.  The Cuthill-McKee parent of a vertex is
+ * its lowest-labeled neighbor in the previous level, so sorting each new level
+ * by (parent label, degree, id) reproduces the serial ordering exactly.
+ */
+template <typename ValueT, typename OffsetT>
+void RcmRelabel(
+    CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+    OffsetT*                    relabel_indices,
+    int                         num_threads)
+{
+    SymmetricAdjacency<OffsetT> adj;
+    adj.Init(csr_matrix, num_threads);
+
+    OffsetT                 num_vertices = adj.num_vertices;
+    std::vector<OffsetT>    label(num_vertices, -1);                // Cuthill-McKee label (-1 unvisited, -2 claimed by the level being built)
+    std::vector<OffsetT>    parent(num_vertices, num_vertices);     // Lowest label among a vertex's previous-level neighbors
+    std::vector<OffsetT>    order;                                  // Vertices in Cuthill-McKee order
+    std::vector<OffsetT>    depth(num_vertices, -1);
+    std::vector<OffsetT>    queue;
+    order.reserve(num_vertices);
+
+    // Start each connected component from a low-degree vertex
+    std::vector<OffsetT> seeds(num_vertices);
+    for (OffsetT v = 0; v < num_vertices; ++v)
+        seeds[v] = v;
+    std::stable_sort(seeds.begin(), seeds.end(), DegreeComparator<OffsetT>(&adj));
+
+    std::vector<std::vector<OffsetT> > thread_levels(num_threads);
+
+    for (OffsetT s = 0; s < num_vertices; ++s)
+    {
+        if (label[seeds[s]] >= 0)
+            continue;
+
+        OffsetT root = PseudoPeripheralVertex(adj, seeds[s], depth, queue);
+        label[root] = OffsetT(order.size());
+        order.push_back(root);
+
+        OffsetT level_begin = OffsetT(order.size()) - 1;
+        OffsetT level_end   = OffsetT(order.size());
+
+        while (level_begin < level_end)
+        {
+            // Claim the unvisited neighbors of the current level, recording their lowest parent label
+            #pragma omp parallel num_threads(num_threads)
+            {
+                std::vector<OffsetT> &next_level = thread_levels[omp_get_thread_num()];
+                next_level.clear();
+
+                #pragma omp for schedule(dynamic, 64)
+                for (OffsetT i = level_begin; i < level_end; ++i)
+                {
+                    OffsetT u = order[i];
+                    for (OffsetT j = adj.offsets[u]; j < adj.offsets[u + 1]; ++j)
+                    {
+                        OffsetT v = adj.neighbors[j];
+                        if (label[v] >= 0)
+                            continue;
+
+                        AtomicMin(&parent[v], i);
+                        if ((label[v] == -1) && __sync_bool_compare_and_swap(&label[v], -1, -2))
+                            next_level.push_back(v);
+                    }
+                }
+            }
+
+            for (int t = 0; t < num_threads; ++t)
+                order.insert(order.end(), thread_levels[t].begin(), thread_levels[t].end());
+
+            std::sort(order.begin() + level_end, order.end(), CuthillMcKeeComparator<OffsetT>(&parent[0], &adj));
+
+            for (OffsetT i = level_end; i < OffsetT(order.size()); ++i)
+                label[order[i]] = i;
+
+            level_begin = level_end;
+            level_end   = OffsetT(order.size());
+        }
+    }
+
+    // Reverse
+    for (OffsetT i = 0; i < num_vertices; ++i)
+        relabel_indices[order[i]] = num_vertices - 1 - i;
+}
+
+
+/******************************************************************************
+ * Degree-based orderings
+ ******************************************************************************/
+
+/**
+ * Counts the nonzeros in each column (the number of times each x entry is gathered)
+ */
+template <typename ValueT, typename OffsetT>
+void ColumnDegrees(
+    CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+    std::vector<OffsetT>        &degrees,
+    int                         num_threads)
+{
+    degrees.assign(csr_matrix.num_cols, 0);
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (OffsetT nz = 0; nz < csr_matrix.num_nonzeros; ++nz)
+        __sync_fetch_and_add(&degrees[csr_matrix.column_indices[nz]], 1);
+}
+
+
+/**
+ * Orders vertices by decreasing degree, breaking ties by id
+ */
+template <typename OffsetT>
+struct DescendingDegreeComparator
+{
+    const OffsetT* degrees;
+
+    DescendingDegreeComparator(const OffsetT* degrees) : degrees(degrees) {}
+
+    bool operator()(OffsetT a, OffsetT b) const
+    {
+        if (degrees[a] != degrees[b])
+            return (degrees[a] > degrees[b]);
+        return (a < b);
+    }
+};
+
+
+/**
+ * Degree-sort relabeling of a square matrix: vertices are renumbered by
+ * decreasing column degree, so the hottest entries of x are packed together.
+ */
+template <typename ValueT, typename OffsetT>
+void DegreeSortRelabel(
+    CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+    OffsetT*                    relabel_indices,
+    int                         num_threads)
+{
+    std::vector<OffsetT> degrees;
+    ColumnDegrees(csr_matrix, degrees, num_threads);
+
+    std::vector<OffsetT> order(csr_matrix.num_rows);
+    for (OffsetT v = 0; v < csr_matrix.num_rows; ++v)
+        order[v] = v;
+    std::sort(order.begin(), order.end(), DescendingDegreeComparator<OffsetT>(&degrees[0]));
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (OffsetT i = 0; i < csr_matrix.num_rows; ++i)
+        relabel_indices[order[i]] = i;
+}
+
+
+/**
+ * Hub-sort relabeling of a square matrix: vertices whose column degree exceeds
+ * the mean (hubs) are moved to the front in decreasing-degree order, while the
+ * remaining vertices keep their original relative order (and thus whatever
+ * locality the input ordering already had).
+ */
+template <typename ValueT, typename OffsetT>
+void HubSortRelabel(
+    CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+    OffsetT*                    relabel_indices,
+    int                         num_threads)
+{
+    std::vector<OffsetT> degrees;
+    ColumnDegrees(csr_matrix, degrees, num_threads);
+
+    double mean_degree = double(csr_matrix.num_nonzeros) / csr_matrix.num_cols;
+
+    std::vector<OffsetT> hubs;
+    std::vector<OffsetT> non_hubs;
+    for (OffsetT v = 0; v < csr_matrix.num_rows; ++v)
+    {
+        if (degrees[v] > mean_degree)
+            hubs.push_back(v);
+        else
+            non_hubs.push_back(v);
+    }
+    std::sort(hubs.begin(), hubs.end(), DescendingDegreeComparator<OffsetT>(&degrees[0]));
+
+    OffsetT num_hubs = OffsetT(hubs.size());
+    for (OffsetT i = 0; i < num_hubs; ++i)
+        relabel_indices[hubs[i]] = i;
+    for (OffsetT i = 0; i < OffsetT(non_hubs.size()); ++i)
+        relabel_indices[non_hubs[i]] = num_hubs + i;
+}
+
+
+/******************************************************************************
+ * Community-based (Rabbit-order style) ordering
+ ******************************************************************************/
+
+/**
+ * Finds the community a vertex has been merged into (with path halving)
+ */
+template <typename OffsetT>
+inline OffsetT CommunityRoot(std::vector<OffsetT> &community, OffsetT v)
+{
+    while (community[v] != v)
+    {
+        community[v] = community[community[v]];
+        v = community[v];
+    }
+    return v;
+}
+
+
+/**
+ * Rabbit-order style relabeling of a square matrix.
+ *
+ * Communities are built by incremental aggregation: vertices are visited in
+ * increasing-degree order and each is merged into the neighboring community
+ * with the largest positive modularity gain.  Edge lists are aggregated lazily
+ * (a community's list is only compacted when it is visited).  The resulting
+ * merge dendrogram is then numbered depth-first, so members of a community,
+ * and of nested sub-communities, receive consecutive ids.
+ */
+template <typename ValueT, typename OffsetT>
+void RabbitRelabel(
+    CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+    OffsetT*                    relabel_indices,
+    int                         num_threads)
+{
+    typedef std::pair<OffsetT, double> Edge;
+
+    SymmetricAdjacency<OffsetT> adj;
+    adj.Init(csr_matrix, num_threads);
+
+    OffsetT num_vertices    = adj.num_vertices;
+    double  total_weight    = double(adj.neighbors.size());         // 2m
+
+    std::vector<std::vector<Edge> > edges(num_vertices);
+    std::vector<double>             strength(num_vertices);         // Weighted degree of each community
+    std::vector<OffsetT>            community(num_vertices);        // Union-find parent
+    std::vector<OffsetT>            first_child(num_vertices, -1);  // Dendrogram
+    std::vector<OffsetT>            next_sibling(num_vertices, -1);
+
+    #pragma omp parallel for schedule(dynamic, 256) num_threads(num_threads)
+    for (OffsetT v = 0; v < num_vertices; ++v)
+    {
+        community[v]    = v;
+        strength[v]     = double(adj.Degree(v));
+        edges[v].reserve(adj.Degree(v));
+        for (OffsetT i = adj.offsets[v]; i < adj.offsets[v + 1]; ++i)
+            edges[v].push_back(Edge(adj.neighbors[i], 1.0));
+    }
+
+    std::vector<OffsetT> visit_order(num_vertices);
+    for (OffsetT v = 0; v < num_vertices; ++v)
+        visit_order[v] = v;
+    std::stable_sort(visit_order.begin(), visit_order.end(), DegreeComparator<OffsetT>(&adj));
+
+    for (OffsetT i = 0; i < num_vertices; ++i)
+    {
+        OffsetT u = visit_order[i];
+
+        // Compact u's edge list onto current communities, dropping internal edges
+        std::vector<Edge> &u_edges = edges[u];
+        for (size_t e = 0; e < u_edges.size(); ++e)
+            u_edges[e].first = CommunityRoot(community, u_edges[e].first);
+        std::sort(u_edges.begin(), u_edges.end());
+
+        size_t num_unique = 0;
+        for (size_t e = 0; e < u_edges.size(); ++e)
+        {
+            if (u_edges[e].first == u)
+                continue;
+            if ((num_unique > 0) && (u_edges[num_unique - 1].first == u_edges[e].first))
+                u_edges[num_unique - 1].second += u_edges[e].second;
+            else
+                u_edges[num_unique++] = u_edges[e];
+        }
+        u_edges.resize(num_unique);
+
+        // Find the neighboring community with the best modularity gain
+        OffsetT best        = -1;
+        double  best_gain   = 0.0;
+        for (size_t e = 0; e < u_edges.size(); ++e)
+        {
+            OffsetT v       = u_edges[e].first;
+            double  gain    = 2.0 * ((u_edges[e].second / total_weight) - (strength[u] * strength[v] / (total_weight * total_weight)));
+            if (gain > best_gain)
+            {
+                best        = v;
+                best_gain   = gain;
+            }
+        }
+
+        if (best < 0)
+            continue;   // u stays a top-level community
+
+        // Merge u into best
+        community[u]        = best;
+        strength[best]      += strength[u];
+        next_sibling[u]     = first_child[best];
+        first_child[best]   = u;
+        edges[best].insert(edges[best].end(), u_edges.begin(), u_edges.end());
+        std::vector<Edge>().swap(u_edges);
+    }
+
+    // Number the dendrogram depth-first, top-level communities in id order
+    OffsetT                 next_id = 0;
+    std::vector<OffsetT>    stack;
+    for (OffsetT root = 0; root < num_vertices; ++root)
+    {
+        if (community[root] != root)
+            continue;
+
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            OffsetT v = stack.back();
+            stack.pop_back();
+            relabel_indices[v] = next_id++;
+
+            // Children were prepended as they merged; push so the earliest merge is visited first
+            for (OffsetT child = first_child[v]; child >= 0; child = next_sibling[child])
+                stack.push_back(child);
+        }
+    }
+}
+
+
+/******************************************************************************
+ * Row clustering (MinHash)
+ ******************************************************************************/
+
+/**
+ * The h-th MinHash function of a column id
+ */
+inline unsigned int MinHashColumn(unsigned int col, unsigned int h)
+{
+    unsigned int x = col * 2654435761u + (h + 1) * 0x9e3779b9u;
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+}
+
+
+/**
+ * Row-only relabeling (row_relabel_indices[old] = new) that clusters rows with
+ * similar column sets, so consecutive rows gather the same X entries.
+ *
+ * Each nonempty row gets num_bands * 2 MinHash values; two rows whose band of
+ * two values match (probability J^2 for column sets of Jaccard similarity J)
+ * are merged into one cluster, unless the merged cluster would hold more than
+ * max_cluster_nonzeros nonzeros (which bounds the distinct X entries it
+ * gathers, and stops chains of weakly similar pairs from joining everything
+ * into one cluster).  Clusters are placed at their lowest row, with
+ * members in original order, so similar rows are pulled up next to each other
+ * while unclustered rows (and empty ones) keep the input order and whatever
+ * locality it had.  Columns are not relabeled; the matrix need not be square.
+ */
+template <typename ValueT, typename OffsetT>
+void MinHashRowRelabel(
+    CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+    OffsetT*                    row_relabel_indices,
+    int                         num_bands,
+    OffsetT                     max_cluster_nonzeros,
+    int                         num_threads)
+{
+    typedef std::pair<unsigned long long, OffsetT> BandKey;
+
+    const int   BAND_HASHES = 2;
+    int         num_hashes  = num_bands * BAND_HASHES;
+    OffsetT     num_rows    = csr_matrix.num_rows;
+
+    // Signatures
+    std::vector<unsigned int> signatures(size_t(num_rows) * num_hashes);
+
+    #pragma omp parallel for schedule(dynamic, 256) num_threads(num_threads)
+    for (OffsetT row = 0; row < num_rows; ++row)
+    {
+        unsigned int* signature = &signatures[size_t(row) * num_hashes];
+        for (int h = 0; h < num_hashes; ++h)
+        {
+            signature[h] = ~0u;
+            for (OffsetT nz = csr_matrix.row_offsets[row]; nz < csr_matrix.row_offsets[row + 1]; ++nz)
+                signature[h] = std::min(signature[h], MinHashColumn(csr_matrix.column_indices[nz], h));
+        }
+    }
+
+    // Merge rows whose bands match (each cluster's root is its lowest row)
+    std::vector<OffsetT> community(num_rows);
+    std::vector<OffsetT> cluster_nonzeros(num_rows);
+    for (OffsetT row = 0; row < num_rows; ++row)
+    {
+        community[row]          = row;
+        cluster_nonzeros[row]   = csr_matrix.row_offsets[row + 1] - csr_matrix.row_offsets[row];
+    }
+
+    std::vector<BandKey> keys;
+    keys.reserve(num_rows);
+    for (int band = 0; band < num_bands; ++band)
+    {
+        keys.clear();
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            if (csr_matrix.row_offsets[row] == csr_matrix.row_offsets[row + 1])
+                continue;
+
+            unsigned int* signature = &signatures[size_t(row) * num_hashes + band * BAND_HASHES];
+            keys.push_back(BandKey((unsigned long long) signature[0] << 32 | signature[1], row));
+        }
+        std::sort(keys.begin(), keys.end());
+
+        for (size_t i = 1; i < keys.size(); ++i)
+        {
+            if (keys[i].first != keys[i - 1].first)
+                continue;
+
+            OffsetT a = std::min(CommunityRoot(community, keys[i - 1].second), CommunityRoot(community, keys[i].second));
+            OffsetT b = std::max(CommunityRoot(community, keys[i - 1].second), CommunityRoot(community, keys[i].second));
+            if ((a != b) && (cluster_nonzeros[a] + cluster_nonzeros[b] <= max_cluster_nonzeros))
+            {
+                community[b]        = a;
+                cluster_nonzeros[a] += cluster_nonzeros[b];
+            }
+        }
+    }
+
+    // Place clusters at their lowest row, members in order (a counting sort on the root)
+    std::vector<OffsetT> cluster_offsets(num_rows + 1, 0);
+    for (OffsetT row = 0; row < num_rows; ++row)
+    {
+        community[row] = CommunityRoot(community, row);
+        cluster_offsets[community[row] + 1]++;
+    }
+    for (OffsetT row = 0; row < num_rows; ++row)
+        cluster_offsets[row + 1] += cluster_offsets[row];
+    for (OffsetT row = 0; row < num_rows; ++row)
+        row_relabel_indices[row] = cluster_offsets[community[row]]++;
+}
+
+
+/******************************************************************************
+ * Reordering dispatch
+ ******************************************************************************/
+
+/**
+ * Computes the named relabeling ("rcm", "degree", "hub", or "rabbit").
+ * Returns false if the name is not recognized.
+ */
+template <typename ValueT, typename OffsetT>
+bool Relabel(
+    const std::string           &method,
+    CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+    OffsetT*                    relabel_indices,
+    int                         num_threads)
+{
+    if (method == "rcm")
+        RcmRelabel(csr_matrix, relabel_indices, num_threads);
+    else if (method == "degree")
+        DegreeSortRelabel(csr_matrix, relabel_indices, num_threads);
+    else if (method == "hub")
+        HubSortRelabel(csr_matrix, relabel_indices, num_threads);
+    else if (method == "rabbit")
+        RabbitRelabel(csr_matrix, relabel_indices, num_threads);
+    else
+        return false;
+
+    return true;
+}
+
@@ -43,8 +43,10 @@
 #include <set>
 #include <list>
 #include <fstream>
+#include <vector>
 #include <stdio.h>
 #include <numa.h>
+#include <omp.h>
 
 #ifdef CUB_MKL
     #include <mkl.h>
@@ -211,6 +213,109 @@ struct CooMatrix
     }
 
 
+    /**
+     * Builds a COO sparse from a CSR matrix with only its rows relabeled
+     * (columns keep their ids, so the matrix need not be square).
+     */
+    template <typename CsrMatrixT>
+    void InitCsrRowRelabel(CsrMatrixT &csr_matrix, OffsetT* row_relabel_indices)
+    {
+        if (coo_tuples)
+        {
+            fprintf(stderr, "Matrix already constructed\n");
+            exit(1);
+        }
+
+        num_rows        = csr_matrix.num_rows;
+        num_cols        = csr_matrix.num_cols;
+        num_nonzeros    = csr_matrix.num_nonzeros;
+        coo_tuples      = new CooTuple[num_nonzeros];
+
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            for (OffsetT nonzero = csr_matrix.row_offsets[row]; nonzero < csr_matrix.row_offsets[row + 1]; ++nonzero)
+            {
+                coo_tuples[nonzero].row = row_relabel_indices[row];
+                coo_tuples[nonzero].col = csr_matrix.column_indices[nonzero];
+                coo_tuples[nonzero].val = csr_matrix.values[nonzero];
+            }
+        }
+    }
+
+
+    /**
+     * Builds a COO sparse from the upper triangle (including the diagonal) of
+     * a CSR matrix.
+     */
+    template <typename CsrMatrixT>
+    void InitCsrTriangle(CsrMatrixT &csr_matrix)
+    {
+        if (coo_tuples)
+        {
+            fprintf(stderr, "Matrix already constructed\n");
+            exit(1);
+        }
+
+        num_rows        = csr_matrix.num_rows;
+        num_cols        = csr_matrix.num_cols;
+        num_nonzeros    = 0;
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            for (OffsetT nonzero = csr_matrix.row_offsets[row]; nonzero < csr_matrix.row_offsets[row + 1]; ++nonzero)
+            {
+                if (csr_matrix.column_indices[nonzero] >= row)
+                    num_nonzeros++;
+            }
+        }
+
+        coo_tuples      = new CooTuple[num_nonzeros];
+
+        OffsetT current_nz = 0;
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            for (OffsetT nonzero = csr_matrix.row_offsets[row]; nonzero < csr_matrix.row_offsets[row + 1]; ++nonzero)
+            {
+                if (csr_matrix.column_indices[nonzero] < row)
+                    continue;
+
+                coo_tuples[current_nz].row = row;
+                coo_tuples[current_nz].col = csr_matrix.column_indices[nonzero];
+                coo_tuples[current_nz].val = csr_matrix.values[nonzero];
+                current_nz++;
+            }
+        }
+    }
+
+
+    /**
+     * Builds a COO sparse from the transpose of a CSR matrix.
+     */
+    template <typename CsrMatrixT>
+    void InitCsrTranspose(CsrMatrixT &csr_matrix)
+    {
+        if (coo_tuples)
+        {
+            fprintf(stderr, "Matrix already constructed\n");
+            exit(1);
+        }
+
+        num_rows        = csr_matrix.num_cols;
+        num_cols        = csr_matrix.num_rows;
+        num_nonzeros    = csr_matrix.num_nonzeros;
+        coo_tuples      = new CooTuple[num_nonzeros];
+
+        for (OffsetT row = 0; row < csr_matrix.num_rows; ++row)
+        {
+            for (OffsetT nonzero = csr_matrix.row_offsets[row]; nonzero < csr_matrix.row_offsets[row + 1]; ++nonzero)
+            {
+                coo_tuples[nonzero].row = csr_matrix.column_indices[nonzero];
+                coo_tuples[nonzero].col = row;
+                coo_tuples[nonzero].val = csr_matrix.values[nonzero];
+            }
+        }
+    }
+
+
     /**
      * Builds a MARKET COO sparse from the given file.
      */
@@ -913,6 +1018,70 @@ struct CsrMatrix
     }
 
 
+    /**
+     * Bandwidth: largest distance of any nonzero from the diagonal
+     */
+    OffsetT Bandwidth()
+    {
+        OffsetT bandwidth = 0;
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            if (row_offsets[row] == row_offsets[row + 1])
+                continue;
+
+            // Columns are sorted within each row
+            OffsetT first_col   = column_indices[row_offsets[row]];
+            OffsetT last_col    = column_indices[row_offsets[row + 1] - 1];
+            bandwidth = std::max(bandwidth, std::max(row - first_col, last_col - row));
+        }
+        return bandwidth;
+    }
+
+
+    /**
+     * Profile (envelope size): sum over rows of the distance from the leftmost
+     * nonzero to the diagonal
+     */
+    long long Profile()
+    {
+        long long profile = 0;
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            if (row_offsets[row] == row_offsets[row + 1])
+                continue;
+
+            OffsetT first_col = column_indices[row_offsets[row]];
+            if (first_col < row)
+                profile += row - first_col;
+        }
+        return profile;
+    }
+
+
+    /**
+     * Whether the matrix is square and numerically symmetric (each (row, col)
+     * has a matching (col, row) entry of equal value)
+     */
+    bool IsSymmetric()
+    {
+        if (num_rows != num_cols)
+            return false;
+
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            for (OffsetT nz = row_offsets[row]; nz < row_offsets[row + 1]; ++nz)
+            {
+                // Columns are sorted within each row
+                OffsetT col         = column_indices[nz];
+                OffsetT* mirror     = std::lower_bound(column_indices + row_offsets[col], column_indices + row_offsets[col + 1], row);
+                if ((mirror == column_indices + row_offsets[col + 1]) || (*mirror != row) || (values[mirror - column_indices] != values[nz]))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+
     /**
      * Display log-histogram to stdout
      */
@@ -977,3 +1146,802 @@ struct CsrMatrix
 
 };
 
+
+
+
+/******************************************************************************
+ * Column-panel CSR matrix type
+ ******************************************************************************/
+
+/**
+ * CSR matrix split into vertical panels of panel_width columns.  Each panel is
+ * stored as its own CSR over only the rows that have nonzeros in that panel
+ * (row_ids maps a compacted panel row back to its original row), so a pass
+ * over one panel touches at most panel_width entries of x and skips the rows
+ * it does not intersect.
+ */
+template<
+    typename ValueT,
+    typename OffsetT>
+struct ColumnPanelCsrMatrix
+{
+    OffsetT     num_rows;
+    OffsetT     num_cols;
+    OffsetT     num_nonzeros;
+    OffsetT     panel_width;
+    OffsetT     num_panels;
+    OffsetT*    panel_row_offsets;      // [num_panels + 1] offsets of each panel's first compacted row
+    OffsetT*    panel_nonzero_offsets;  // [num_panels + 1] offsets of each panel's first nonzero
+    OffsetT*    row_ids;                // Original row of each compacted panel row
+    OffsetT*    row_end_offsets;        // End offset of each compacted panel row (relative to its panel's first nonzero)
+    OffsetT*    column_indices;
+    ValueT*     values;
+
+
+    /**
+     * Initializer.  Rows are split evenly across threads; each thread counts
+     * its rows' panel segments, the counts are scanned panel-major so that
+     * compacted rows stay in ascending order within each panel, and each thread
+     * then scatters its segments into place.
+     */
+    void Init(
+        CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+        OffsetT                     panel_width,
+        int                         num_threads)
+    {
+        this->panel_width   = panel_width;
+        num_rows            = csr_matrix.num_rows;
+        num_cols            = csr_matrix.num_cols;
+        num_nonzeros        = csr_matrix.num_nonzeros;
+        num_panels          = std::max(OffsetT(1), (num_cols + panel_width - 1) / panel_width);
+
+        std::vector<OffsetT> thread_panel_rows(num_threads * num_panels, 0);
+        std::vector<OffsetT> thread_panel_nonzeros(num_threads * num_panels, 0);
+
+        // Count panel segments
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (int tid = 0; tid < num_threads; ++tid)
+        {
+            OffsetT row_begin   = OffsetT((long long) num_rows * tid / num_threads);
+            OffsetT row_end     = OffsetT((long long) num_rows * (tid + 1) / num_threads);
+            OffsetT *rows       = &thread_panel_rows[tid * num_panels];
+            OffsetT *nonzeros   = &thread_panel_nonzeros[tid * num_panels];
+
+            for (OffsetT row = row_begin; row < row_end; ++row)
+            {
+                OffsetT nz = csr_matrix.row_offsets[row];
+                while (nz < csr_matrix.row_offsets[row + 1])
+                {
+                    // Columns are sorted within each row
+                    OffsetT panel       = csr_matrix.column_indices[nz] / panel_width;
+                    OffsetT panel_end   = (panel + 1) * panel_width;
+                    OffsetT segment_end = nz;
+                    while ((segment_end < csr_matrix.row_offsets[row + 1]) && (csr_matrix.column_indices[segment_end] < panel_end))
+                        ++segment_end;
+
+                    rows[panel]++;
+                    nonzeros[panel] += segment_end - nz;
+                    nz = segment_end;
+                }
+            }
+        }
+
+        // Panel-major exclusive scan of the per-thread counts
+        panel_row_offsets       = new OffsetT[num_panels + 1];
+        panel_nonzero_offsets   = new OffsetT[num_panels + 1];
+
+        OffsetT running_rows        = 0;
+        OffsetT running_nonzeros    = 0;
+        for (OffsetT panel = 0; panel < num_panels; ++panel)
+        {
+            panel_row_offsets[panel]        = running_rows;
+            panel_nonzero_offsets[panel]    = running_nonzeros;
+            for (int tid = 0; tid < num_threads; ++tid)
+            {
+                OffsetT rows        = thread_panel_rows[tid * num_panels + panel];
+                OffsetT nonzeros    = thread_panel_nonzeros[tid * num_panels + panel];
+                thread_panel_rows[tid * num_panels + panel]     = running_rows;
+                thread_panel_nonzeros[tid * num_panels + panel] = running_nonzeros;
+                running_rows        += rows;
+                running_nonzeros    += nonzeros;
+            }
+        }
+        panel_row_offsets[num_panels]       = running_rows;
+        panel_nonzero_offsets[num_panels]   = running_nonzeros;
+
+#ifdef CUB_MKL
+        row_ids         = (OffsetT*) mkl_malloc(sizeof(OffsetT) * running_rows, 4096);
+        row_end_offsets = (OffsetT*) mkl_malloc(sizeof(OffsetT) * running_rows, 4096);
+        column_indices  = (OffsetT*) mkl_malloc(sizeof(OffsetT) * num_nonzeros, 4096);
+        values          = (ValueT*) mkl_malloc(sizeof(ValueT) * num_nonzeros, 4096);
+#else
+        row_ids         = new OffsetT[running_rows];
+        row_end_offsets = new OffsetT[running_rows];
+        column_indices  = new OffsetT[num_nonzeros];
+        values          = new ValueT[num_nonzeros];
+#endif
+
+        // Scatter panel segments
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (int tid = 0; tid < num_threads; ++tid)
+        {
+            OffsetT row_begin   = OffsetT((long long) num_rows * tid / num_threads);
+            OffsetT row_end     = OffsetT((long long) num_rows * (tid + 1) / num_threads);
+            OffsetT *rows       = &thread_panel_rows[tid * num_panels];
+            OffsetT *nonzeros   = &thread_panel_nonzeros[tid * num_panels];
+
+            for (OffsetT row = row_begin; row < row_end; ++row)
+            {
+                OffsetT nz = csr_matrix.row_offsets[row];
+                while (nz < csr_matrix.row_offsets[row + 1])
+                {
+                    OffsetT panel       = csr_matrix.column_indices[nz] / panel_width;
+                    OffsetT panel_end   = (panel + 1) * panel_width;
+                    for (; (nz < csr_matrix.row_offsets[row + 1]) && (csr_matrix.column_indices[nz] < panel_end); ++nz)
+                    {
+                        column_indices[nonzeros[panel]] = csr_matrix.column_indices[nz];
+                        values[nonzeros[panel]]         = csr_matrix.values[nz];
+                        nonzeros[panel]++;
+                    }
+
+                    row_ids[rows[panel]]            = row;
+                    row_end_offsets[rows[panel]]    = nonzeros[panel] - panel_nonzero_offsets[panel];
+                    rows[panel]++;
+                }
+            }
+        }
+    }
+
+
+    /**
+     * Clear
+     */
+    void Clear()
+    {
+        if (panel_row_offsets)      delete[] panel_row_offsets;
+        if (panel_nonzero_offsets)  delete[] panel_nonzero_offsets;
+#ifdef CUB_MKL
+        if (row_ids)                mkl_free(row_ids);
+        if (row_end_offsets)        mkl_free(row_end_offsets);
+        if (column_indices)         mkl_free(column_indices);
+        if (values)                 mkl_free(values);
+#else
+        if (row_ids)                delete[] row_ids;
+        if (row_end_offsets)        delete[] row_end_offsets;
+        if (column_indices)         delete[] column_indices;
+        if (values)                 delete[] values;
+#endif
+
+        panel_row_offsets       = NULL;
+        panel_nonzero_offsets   = NULL;
+        row_ids                 = NULL;
+        row_end_offsets         = NULL;
+        column_indices          = NULL;
+        values                  = NULL;
+    }
+
+
+    /**
+     * Constructor
+     */
+    ColumnPanelCsrMatrix(
+        CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+        OffsetT                     panel_width,
+        int                         num_threads)
+    {
+        Init(csr_matrix, panel_width, num_threads);
+    }
+
+
+    /**
+     * Destructor
+     */
+    ~ColumnPanelCsrMatrix()
+    {
+        Clear();
+    }
+
+
+    /**
+     * Number of compacted rows in the given panel
+     */
+    OffsetT PanelRows(OffsetT panel)
+    {
+        return panel_row_offsets[panel + 1] - panel_row_offsets[panel];
+    }
+
+
+    /**
+     * Number of nonzeros in the given panel
+     */
+    OffsetT PanelNonzeros(OffsetT panel)
+    {
+        return panel_nonzero_offsets[panel + 1] - panel_nonzero_offsets[panel];
+    }
+};
+
+
+
+
+/******************************************************************************
+ * Doubly-compressed CSR matrix type
+ ******************************************************************************/
+
+/**
+ * Doubly-compressed (hypersparse) CSR matrix: row_offsets only covers the
+ * num_nonempty_rows rows that have nonzeros, and row_ids maps each of them
+ * back to its original row.
+ */
+template<
+    typename ValueT,
+    typename OffsetT>
+struct DcsrMatrix
+{
+    OffsetT     num_rows;
+    OffsetT     num_cols;
+    OffsetT     num_nonzeros;
+    OffsetT     num_nonempty_rows;
+    OffsetT*    row_ids;                // [num_nonempty_rows] original row of each stored row
+    OffsetT*    row_offsets;            // [num_nonempty_rows + 1]
+    OffsetT*    column_indices;
+    ValueT*     values;
+
+
+    /**
+     * Initializer
+     */
+    void Init(
+        CsrMatrix<ValueT, OffsetT>  &csr_matrix)
+    {
+        num_rows            = csr_matrix.num_rows;
+        num_cols            = csr_matrix.num_cols;
+        num_nonzeros        = csr_matrix.num_nonzeros;
+        num_nonempty_rows   = 0;
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            if (csr_matrix.row_offsets[row] != csr_matrix.row_offsets[row + 1])
+                num_nonempty_rows++;
+        }
+
+#ifdef CUB_MKL
+        row_ids         = (OffsetT*) mkl_malloc(sizeof(OffsetT) * num_nonempty_rows, 4096);
+        row_offsets     = (OffsetT*) mkl_malloc(sizeof(OffsetT) * (num_nonempty_rows + 1), 4096);
+        column_indices  = (OffsetT*) mkl_malloc(sizeof(OffsetT) * num_nonzeros, 4096);
+        values          = (ValueT*) mkl_malloc(sizeof(ValueT) * num_nonzeros, 4096);
+#else
+        row_ids         = new OffsetT[num_nonempty_rows];
+        row_offsets     = new OffsetT[num_nonempty_rows + 1];
+        column_indices  = new OffsetT[num_nonzeros];
+        values          = new ValueT[num_nonzeros];
+#endif
+
+        OffsetT current_row = 0;
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            if (csr_matrix.row_offsets[row] != csr_matrix.row_offsets[row + 1])
+            {
+                row_ids[current_row]        = row;
+                row_offsets[current_row]    = csr_matrix.row_offsets[row];
+                current_row++;
+            }
+        }
+        row_offsets[num_nonempty_rows] = num_nonzeros;
+
+        memcpy(column_indices, csr_matrix.column_indices, sizeof(OffsetT) * num_nonzeros);
+        memcpy(values, csr_matrix.values, sizeof(ValueT) * num_nonzeros);
+    }
+
+
+    /**
+     * Clear
+     */
+    void Clear()
+    {
+#ifdef CUB_MKL
+        if (row_ids)        mkl_free(row_ids);
+        if (row_offsets)    mkl_free(row_offsets);
+        if (column_indices) mkl_free(column_indices);
+        if (values)         mkl_free(values);
+#else
+        if (row_ids)        delete[] row_ids;
+        if (row_offsets)    delete[] row_offsets;
+        if (column_indices) delete[] column_indices;
+        if (values)         delete[] values;
+#endif
+
+        row_ids         = NULL;
+        row_offsets     = NULL;
+        column_indices  = NULL;
+        values          = NULL;
+    }
+
+
+    /**
+     * Constructor
+     */
+    DcsrMatrix(
+        CsrMatrix<ValueT, OffsetT>  &csr_matrix)
+    {
+        Init(csr_matrix);
+    }
+
+
+    /**
+     * Destructor
+     */
+    ~DcsrMatrix()
+    {
+        Clear();
+    }
+};
+
+
+
+
+/******************************************************************************
+ * Adaptive sparse tiled CSR matrix type
+ ******************************************************************************/
+
+/**
+ * CSR matrix split by adaptive sparse tiling (ASpT).  Rows are grouped into
+ * panels of panel_rows consecutive rows; a column that holds at least
+ * min_reuse of a panel's nonzeros is a dense column of that panel.  The
+ * nonzeros on dense columns form the panel's dense tile, stored row by row
+ * with column indices local to the panel's dense-column list, so the rows of
+ * a right-hand side they touch can be staged once per panel.  All other
+ * nonzeros form the remainder, an ordinary CSR matrix of the same shape.
+ */
+template<
+    typename ValueT,
+    typename OffsetT>
+struct AdaptiveTiledCsrMatrix
+{
+    OffsetT                         num_rows;
+    OffsetT                         num_cols;
+    OffsetT                         num_nonzeros;
+    OffsetT                         panel_rows;
+    OffsetT                         num_panels;
+    OffsetT                         min_reuse;
+    OffsetT                         max_panel_columns;      // Largest dense-column list of any panel
+    OffsetT*                        panel_column_offsets;   // [num_panels + 1] offsets of each panel's dense-column list
+    OffsetT*                        panel_tile_offsets;     // [num_panels + 1] offsets of each panel's first tile nonzero
+    OffsetT*                        dense_columns;          // Original column of each panel's dense columns, ascending within a panel
+    OffsetT*                        tile_row_offsets;       // [num_rows + 1]
+    OffsetT*                        tile_column_indices;    // Index into the row's panel's dense-column list
+    ValueT*                         tile_values;
+    CsrMatrix<ValueT, OffsetT>*     remainder;
+
+
+    /**
+     * Initializer.  Panels are independent: each thread sorts the column
+     * indices of its panels to find their dense columns and counts each row's
+     * tile nonzeros, the counts are scanned, and each thread then splits its
+     * panels' nonzeros between the tiles and the remainder.
+     */
+    void Init(
+        CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+        OffsetT                     panel_rows,
+        OffsetT                     min_reuse,
+        int                         num_threads)
+    {
+        this->panel_rows    = panel_rows;
+        this->min_reuse     = min_reuse;
+        num_rows            = csr_matrix.num_rows;
+        num_cols            = csr_matrix.num_cols;
+        num_nonzeros        = csr_matrix.num_nonzeros;
+        num_panels          = (num_rows + panel_rows - 1) / panel_rows;
+
+        std::vector<std::vector<OffsetT> >  panel_columns(num_panels);
+        std::vector<OffsetT>                row_tile_nonzeros(num_rows + 1, 0);
+
+        // Find each panel's dense columns and count each row's tile nonzeros
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (OffsetT panel = 0; panel < num_panels; ++panel)
+        {
+            OffsetT row_begin   = panel * panel_rows;
+            OffsetT row_end     = std::min(row_begin + panel_rows, num_rows);
+
+            std::vector<OffsetT> columns(
+                csr_matrix.column_indices + csr_matrix.row_offsets[row_begin],
+                csr_matrix.column_indices + csr_matrix.row_offsets[row_end]);
+            std::sort(columns.begin(), columns.end());
+
+            std::vector<OffsetT> &dense = panel_columns[panel];
+            for (size_t i = 0; i < columns.size();)
+            {
+                size_t run_end = i;
+                while ((run_end < columns.size()) && (columns[run_end] == columns[i]))
+                    ++run_end;
+                if (OffsetT(run_end - i) >= min_reuse)
+                    dense.push_back(columns[i]);
+                i = run_end;
+            }
+
+            for (OffsetT row = row_begin; row < row_end; ++row)
+            {
+                for (OffsetT nz = csr_matrix.row_offsets[row]; nz < csr_matrix.row_offsets[row + 1]; ++nz)
+                {
+                    if (std::binary_search(dense.begin(), dense.end(), csr_matrix.column_indices[nz]))
+                        row_tile_nonzeros[row]++;
+                }
+            }
+        }
+
+        // Scan the dense-column lists and tile rows
+        panel_column_offsets    = new OffsetT[num_panels + 1];
+        panel_tile_offsets      = new OffsetT[num_panels + 1];
+        max_panel_columns       = 0;
+
+        OffsetT running_columns = 0;
+        for (OffsetT panel = 0; panel < num_panels; ++panel)
+        {
+            panel_column_offsets[panel] = running_columns;
+            running_columns             += panel_columns[panel].size();
+            max_panel_columns           = std::max(max_panel_columns, OffsetT(panel_columns[panel].size()));
+        }
+        panel_column_offsets[num_panels] = running_columns;
+
+#ifdef CUB_MKL
+        tile_row_offsets    = (OffsetT*) mkl_malloc(sizeof(OffsetT) * (num_rows + 1), 4096);
+#else
+        tile_row_offsets    = new OffsetT[num_rows + 1];
+#endif
+
+        OffsetT running_nonzeros = 0;
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            tile_row_offsets[row]   = running_nonzeros;
+            running_nonzeros        += row_tile_nonzeros[row];
+        }
+        tile_row_offsets[num_rows] = running_nonzeros;
+
+        for (OffsetT panel = 0; panel <= num_panels; ++panel)
+            panel_tile_offsets[panel] = tile_row_offsets[std::min(panel * panel_rows, num_rows)];
+
+#ifdef CUB_MKL
+        dense_columns       = (OffsetT*) mkl_malloc(sizeof(OffsetT) * running_columns, 4096);
+        tile_column_indices = (OffsetT*) mkl_malloc(sizeof(OffsetT) * running_nonzeros, 4096);
+        tile_values         = (ValueT*) mkl_malloc(sizeof(ValueT) * running_nonzeros, 4096);
+#else
+        dense_columns       = new OffsetT[running_columns];
+        tile_column_indices = new OffsetT[running_nonzeros];
+        tile_values         = new ValueT[running_nonzeros];
+#endif
+
+        CooMatrix<ValueT, OffsetT> remainder_coo;
+        remainder_coo.num_rows      = num_rows;
+        remainder_coo.num_cols      = num_cols;
+        remainder_coo.num_nonzeros  = num_nonzeros - running_nonzeros;
+        remainder_coo.coo_tuples    = new typename CooMatrix<ValueT, OffsetT>::CooTuple[remainder_coo.num_nonzeros];
+
+        // Split each panel's nonzeros between its tile and the remainder
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (OffsetT panel = 0; panel < num_panels; ++panel)
+        {
+            OffsetT                 row_begin   = panel * panel_rows;
+            OffsetT                 row_end     = std::min(row_begin + panel_rows, num_rows);
+            std::vector<OffsetT>    &dense      = panel_columns[panel];
+
+            std::copy(dense.begin(), dense.end(), dense_columns + panel_column_offsets[panel]);
+
+            OffsetT tile_nz         = tile_row_offsets[row_begin];
+            OffsetT remainder_nz    = csr_matrix.row_offsets[row_begin] - tile_nz;
+            for (OffsetT row = row_begin; row < row_end; ++row)
+            {
+                for (OffsetT nz = csr_matrix.row_offsets[row]; nz < csr_matrix.row_offsets[row + 1]; ++nz)
+                {
+                    OffsetT col = csr_matrix.column_indices[nz];
+                    typename std::vector<OffsetT>::iterator it = std::lower_bound(dense.begin(), dense.end(), col);
+                    if ((it != dense.end()) && (*it == col))
+                    {
+                        tile_column_indices[tile_nz]    = OffsetT(it - dense.begin());
+                        tile_values[tile_nz]            = csr_matrix.values[nz];
+                        tile_nz++;
+                    }
+                    else
+                    {
+                        remainder_coo.coo_tuples[remainder_nz].row = row;
+                        remainder_coo.coo_tuples[remainder_nz].col = col;
+                        remainder_coo.coo_tuples[remainder_nz].val = csr_matrix.values[nz];
+                        remainder_nz++;
+                    }
+                }
+            }
+        }
+
+        remainder = new CsrMatrix<ValueT, OffsetT>(remainder_coo);
+    }
+
+
+    /**
+     * Clear
+     */
+    void Clear()
+    {
+        if (panel_column_offsets)   delete[] panel_column_offsets;
+        if (panel_tile_offsets)     delete[] panel_tile_offsets;
+#ifdef CUB_MKL
+        if (dense_columns)          mkl_free(dense_columns);
+        if (tile_row_offsets)       mkl_free(tile_row_offsets);
+        if (tile_column_indices)    mkl_free(tile_column_indices);
+        if (tile_values)            mkl_free(tile_values);
+#else
+        if (dense_columns)          delete[] dense_columns;
+        if (tile_row_offsets)       delete[] tile_row_offsets;
+        if (tile_column_indices)    delete[] tile_column_indices;
+        if (tile_values)            delete[] tile_values;
+#endif
+        if (remainder)              delete remainder;
+
+        panel_column_offsets    = NULL;
+        panel_tile_offsets      = NULL;
+        dense_columns           = NULL;
+        tile_row_offsets        = NULL;
+        tile_column_indices     = NULL;
+        tile_values             = NULL;
+        remainder               = NULL;
+    }
+
+
+    /**
+     * Constructor
+     */
+    AdaptiveTiledCsrMatrix(
+        CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+        OffsetT                     panel_rows,
+        OffsetT                     min_reuse,
+        int                         num_threads)
+    {
+        Init(csr_matrix, panel_rows, min_reuse, num_threads);
+    }
+
+
+    /**
+     * Destructor
+     */
+    ~AdaptiveTiledCsrMatrix()
+    {
+        Clear();
+    }
+
+
+    /**
+     * Number of dense columns in the given panel
+     */
+    OffsetT PanelColumns(OffsetT panel)
+    {
+        return panel_column_offsets[panel + 1] - panel_column_offsets[panel];
+    }
+
+
+    /**
+     * Number of nonzeros held in dense tiles
+     */
+    OffsetT TileNonzeros()
+    {
+        return tile_row_offsets[num_rows];
+    }
+};
+
+
+
+
+
+/******************************************************************************
+ * Hub-split CSR matrix type
+ ******************************************************************************/
+
+/**
+ * CSR matrix with its hubs split out.  Rows holding at least density *
+ * num_cols nonzeros are stored as dense rows; of the remaining entries, the
+ * (at most MAX_HOT_COLUMNS) most populated columns holding at least density *
+ * num_rows of them are stored as a dense num_rows x hot_width column block
+ * (row-major, hot_width the number of hot columns rounded up to a power of
+ * two, padded with zeros).  Everything else is a CSR remainder over all rows,
+ * in which the dense rows are empty.
+ */
+template<
+    typename ValueT,
+    typename OffsetT>
+struct HubSplitCsrMatrix
+{
+    enum
+    {
+        MAX_HOT_COLUMNS = 8,
+    };
+
+    OffsetT                         num_rows;
+    OffsetT                         num_cols;
+    OffsetT                         num_nonzeros;
+    OffsetT                         num_dense_rows;
+    OffsetT                         dense_row_nonzeros;                 // Nonzeros of A in the dense rows
+    OffsetT                         num_hot_columns;
+    OffsetT                         hot_nonzeros;                       // Nonzeros of A in the hot-column block
+    int                             hot_width;                          // Hot-column block width (0, 1, 2, 4 or 8)
+    OffsetT                         hot_columns[MAX_HOT_COLUMNS];       // Original column of each hot column (padding: column 0)
+    OffsetT*                        dense_rows;                         // Original row of each dense row
+    ValueT*                         dense_values;                       // [num_dense_rows x num_cols] row-major
+    ValueT*                         hot_values;                         // [num_rows x hot_width] row-major
+    CsrMatrix<ValueT, OffsetT>*     remainder;
+
+
+    /**
+     * Initializer
+     */
+    void Init(
+        CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+        double                      density,
+        int                         num_threads)
+    {
+        num_rows            = csr_matrix.num_rows;
+        num_cols            = csr_matrix.num_cols;
+        num_nonzeros        = csr_matrix.num_nonzeros;
+        dense_row_nonzeros  = 0;
+        hot_nonzeros        = 0;
+
+        // Dense rows
+        std::vector<OffsetT> rows;
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            OffsetT row_length = csr_matrix.row_offsets[row + 1] - csr_matrix.row_offsets[row];
+            if ((row_length > 0) && (row_length >= density * num_cols))
+            {
+                rows.push_back(row);
+                dense_row_nonzeros += row_length;
+            }
+        }
+        num_dense_rows = OffsetT(rows.size());
+
+        std::vector<char> is_dense_row(num_rows, 0);
+        for (OffsetT i = 0; i < num_dense_rows; ++i)
+            is_dense_row[rows[i]] = 1;
+
+        // Hot columns, most populated first, among the entries outside the dense rows
+        std::vector<OffsetT> column_degrees(num_cols, 0);
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            if (is_dense_row[row])
+                continue;
+            for (OffsetT nz = csr_matrix.row_offsets[row]; nz < csr_matrix.row_offsets[row + 1]; ++nz)
+                column_degrees[csr_matrix.column_indices[nz]]++;
+        }
+
+        std::vector<std::pair<OffsetT, OffsetT> > candidates;
+        for (OffsetT col = 0; col < num_cols; ++col)
+        {
+            if ((column_degrees[col] > 0) && (column_degrees[col] >= density * num_rows))
+                candidates.push_back(std::make_pair(-column_degrees[col], col));
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        num_hot_columns = std::min(OffsetT(candidates.size()), OffsetT(MAX_HOT_COLUMNS));
+        hot_width       = 0;
+        while (hot_width < num_hot_columns)
+            hot_width = std::max(1, hot_width * 2);
+
+        std::vector<int> hot_slot(num_cols, -1);
+        for (int h = 0; h < MAX_HOT_COLUMNS; ++h)
+        {
+            hot_columns[h] = (h < num_hot_columns) ? candidates[h].second : 0;
+            if (h < num_hot_columns)
+            {
+                hot_slot[hot_columns[h]] = h;
+                hot_nonzeros += column_degrees[hot_columns[h]];
+            }
+        }
+
+#ifdef CUB_MKL
+        dense_rows      = (OffsetT*) mkl_malloc(sizeof(OffsetT) * std::max(num_dense_rows, OffsetT(1)), 4096);
+        dense_values    = (ValueT*) mkl_malloc(sizeof(ValueT) * std::max(size_t(num_dense_rows) * num_cols, size_t(1)), 4096);
+        hot_values      = (ValueT*) mkl_malloc(sizeof(ValueT) * std::max(size_t(num_rows) * hot_width, size_t(1)), 4096);
+#else
+        dense_rows      = new OffsetT[std::max(num_dense_rows, OffsetT(1))];
+        dense_values    = new ValueT[std::max(size_t(num_dense_rows) * num_cols, size_t(1))];
+        hot_values      = new ValueT[std::max(size_t(num_rows) * hot_width, size_t(1))];
+#endif
+        std::copy(rows.begin(), rows.end(), dense_rows);
+        std::fill(dense_values, dense_values + size_t(num_dense_rows) * num_cols, ValueT(0));
+        std::fill(hot_values, hot_values + size_t(num_rows) * hot_width, ValueT(0));
+
+        // Dense rows
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+        for (OffsetT i = 0; i < num_dense_rows; ++i)
+        {
+            for (OffsetT nz = csr_matrix.row_offsets[dense_rows[i]]; nz < csr_matrix.row_offsets[dense_rows[i] + 1]; ++nz)
+                dense_values[size_t(i) * num_cols + csr_matrix.column_indices[nz]] = csr_matrix.values[nz];
+        }
+
+        // Split the other rows between the hot-column block and the remainder
+        std::vector<OffsetT> remainder_offsets(num_rows + 1, 0);
+
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            if (is_dense_row[row])
+                continue;
+            for (OffsetT nz = csr_matrix.row_offsets[row]; nz < csr_matrix.row_offsets[row + 1]; ++nz)
+            {
+                if (hot_slot[csr_matrix.column_indices[nz]] < 0)
+                    remainder_offsets[row + 1]++;
+            }
+        }
+        for (OffsetT row = 0; row < num_rows; ++row)
+            remainder_offsets[row + 1] += remainder_offsets[row];
+
+        CooMatrix<ValueT, OffsetT> remainder_coo;
+        remainder_coo.num_rows      = num_rows;
+        remainder_coo.num_cols      = num_cols;
+        remainder_coo.num_nonzeros  = remainder_offsets[num_rows];
+        remainder_coo.coo_tuples    = new typename CooMatrix<ValueT, OffsetT>::CooTuple[remainder_coo.num_nonzeros];
+
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (OffsetT row = 0; row < num_rows; ++row)
+        {
+            if (is_dense_row[row])
+                continue;
+
+            OffsetT remainder_nz = remainder_offsets[row];
+            for (OffsetT nz = csr_matrix.row_offsets[row]; nz < csr_matrix.row_offsets[row + 1]; ++nz)
+            {
+                OffsetT col = csr_matrix.column_indices[nz];
+                if (hot_slot[col] >= 0)
+                {
+                    hot_values[size_t(row) * hot_width + hot_slot[col]] = csr_matrix.values[nz];
+                }
+                else
+                {
+                    remainder_coo.coo_tuples[remainder_nz].row = row;
+                    remainder_coo.coo_tuples[remainder_nz].col = col;
+                    remainder_coo.coo_tuples[remainder_nz].val = csr_matrix.values[nz];
+                    remainder_nz++;
+                }
+            }
+        }
+
+        remainder = new CsrMatrix<ValueT, OffsetT>(remainder_coo);
+    }
+
+
+    /**
+     * Clear
+     */
+    void Clear()
+    {
+#ifdef CUB_MKL
+        if (dense_rows)     mkl_free(dense_rows);
+        if (dense_values)   mkl_free(dense_values);
+        if (hot_values)     mkl_free(hot_values);
+#else
+        if (dense_rows)     delete[] dense_rows;
+        if (dense_values)   delete[] dense_values;
+        if (hot_values)     delete[] hot_values;
+#endif
+        if (remainder)      delete remainder;
+
+        dense_rows      = NULL;
+        dense_values    = NULL;
+        hot_values      = NULL;
+        remainder       = NULL;
+    }
+
+
+    /**
+     * Constructor
+     */
+    HubSplitCsrMatrix(
+        CsrMatrix<ValueT, OffsetT>  &csr_matrix,
+        double                      density,
+        int                         num_threads)
+    {
+        Init(csr_matrix, density, num_threads);
+    }
+
+
+    /**
+     * Destructor
+     */
+    ~HubSplitCsrMatrix()
+    {
+        Clear();
+    }
+};
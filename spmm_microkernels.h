@@ -0,0 +1,1201 @@
+/******************************************************************************
+ * Copyright (c) 2011-2015, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ * Register-tiled SpMM row microkernels.  A tile of TILE_K output columns for
+ * one row is held in SIMD registers while the row's nonzeros stream past,
+ * each one broadcast and FMA'd against TILE_K contiguous values of a
+ * row-major X.  SpmmRow() covers any number of vectors by composing tiles.
+ * Tiles accumulate over a semiring (PlusTimes by default; MaxTimes/MinTimes
+ * for max/min aggregation).
+ * X may be stored in a narrower type than the accumulators (fp32 X for fp64
+ * A and Y); it is widened as it is loaded.
+ * StreamingLineBuffer writes finished output rows with non-temporal stores.
+ * SpmmScratch holds the per-thread carry-outs of the merge-path kernels.
+ ******************************************************************************/
+
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <limits>
+
+
+/******************************************************************************
+ * SIMD traits
+ ******************************************************************************/
+
+/**
+ * Scalar "vector" of one ValueT, with the same interface as SimdTraits
+ */
+template <typename ValueT>
+struct ScalarTraits
+{
+    typedef ValueT VecT;
+    enum { WIDTH = 1 };
+
+    static VecT Zero()                              { return 0.0; }
+    static VecT Load(const ValueT* p)               { return *p; }
+    template <typename InputT>
+    static VecT Load(const InputT* p)               { return VecT(*p); }
+    static void Store(ValueT* p, VecT v)            { *p = v; }
+    static VecT Broadcast(ValueT a)                 { return a; }
+    static VecT Gather(const ValueT* p, const int* i) { return p[*i]; }
+    static VecT Fma(VecT a, VecT b, VecT c)         { return a * b + c; }
+    static VecT Add(VecT a, VecT b)                 { return a + b; }
+    static VecT Mul(VecT a, VecT b)                 { return a * b; }
+    static VecT Max(VecT a, VecT b)                 { return (a < b) ? b : a; }
+    static VecT Min(VecT a, VecT b)                 { return (b < a) ? b : a; }
+};
+
+
+/**
+ * Widest vector type available for ValueT (AVX-512, then AVX2+FMA, then scalar)
+ */
+template <typename ValueT>
+struct SimdTraits;
+
+#if defined(__AVX512F__)
+
+template <>
+struct SimdTraits<double>
+{
+    typedef __m512d VecT;
+    enum { WIDTH = 8 };
+
+    static VecT Zero()                              { return _mm512_setzero_pd(); }
+    static VecT Load(const double* p)               { return _mm512_loadu_pd(p); }
+    static VecT Load(const float* p)                { return _mm512_cvtps_pd(_mm256_loadu_ps(p)); }
+    static void Store(double* p, VecT v)            { _mm512_storeu_pd(p, v); }
+    static VecT Broadcast(double a)                 { return _mm512_set1_pd(a); }
+    static VecT Gather(const double* p, const int* i) { return _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*) i), p, 8); }
+    static VecT Fma(VecT a, VecT b, VecT c)         { return _mm512_fmadd_pd(a, b, c); }
+    static VecT Add(VecT a, VecT b)                 { return _mm512_add_pd(a, b); }
+    static VecT Mul(VecT a, VecT b)                 { return _mm512_mul_pd(a, b); }
+    static VecT Max(VecT a, VecT b)                 { return _mm512_max_pd(a, b); }
+    static VecT Min(VecT a, VecT b)                 { return _mm512_min_pd(a, b); }
+};
+
+template <>
+struct SimdTraits<float>
+{
+    typedef __m512 VecT;
+    enum { WIDTH = 16 };
+
+    static VecT Zero()                              { return _mm512_setzero_ps(); }
+    static VecT Load(const float* p)                { return _mm512_loadu_ps(p); }
+    static void Store(float* p, VecT v)             { _mm512_storeu_ps(p, v); }
+    static VecT Broadcast(float a)                  { return _mm512_set1_ps(a); }
+    static VecT Gather(const float* p, const int* i) { return _mm512_i32gather_ps(_mm512_loadu_si512(i), p, 4); }
+    static VecT Fma(VecT a, VecT b, VecT c)         { return _mm512_fmadd_ps(a, b, c); }
+    static VecT Add(VecT a, VecT b)                 { return _mm512_add_ps(a, b); }
+    static VecT Mul(VecT a, VecT b)                 { return _mm512_mul_ps(a, b); }
+    static VecT Max(VecT a, VecT b)                 { return _mm512_max_ps(a, b); }
+    static VecT Min(VecT a, VecT b)                 { return _mm512_min_ps(a, b); }
+};
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+template <>
+struct SimdTraits<double>
+{
+    typedef __m256d VecT;
+    enum { WIDTH = 4 };
+
+    static VecT Zero()                              { return _mm256_setzero_pd(); }
+    static VecT Load(const double* p)               { return _mm256_loadu_pd(p); }
+    static VecT Load(const float* p)                { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+    static void Store(double* p, VecT v)            { _mm256_storeu_pd(p, v); }
+    static VecT Broadcast(double a)                 { return _mm256_set1_pd(a); }
+    static VecT Gather(const double* p, const int* i) { return _mm256_i32gather_pd(p, _mm_loadu_si128((const __m128i*) i), 8); }
+    static VecT Fma(VecT a, VecT b, VecT c)         { return _mm256_fmadd_pd(a, b, c); }
+    static VecT Add(VecT a, VecT b)                 { return _mm256_add_pd(a, b); }
+    static VecT Mul(VecT a, VecT b)                 { return _mm256_mul_pd(a, b); }
+    static VecT Max(VecT a, VecT b)                 { return _mm256_max_pd(a, b); }
+    static VecT Min(VecT a, VecT b)                 { return _mm256_min_pd(a, b); }
+};
+
+template <>
+struct SimdTraits<float>
+{
+    typedef __m256 VecT;
+    enum { WIDTH = 8 };
+
+    static VecT Zero()                              { return _mm256_setzero_ps(); }
+    static VecT Load(const float* p)                { return _mm256_loadu_ps(p); }
+    static void Store(float* p, VecT v)             { _mm256_storeu_ps(p, v); }
+    static VecT Broadcast(float a)                  { return _mm256_set1_ps(a); }
+    static VecT Gather(const float* p, const int* i) { return _mm256_i32gather_ps(p, _mm256_loadu_si256((const __m256i*) i), 4); }
+    static VecT Fma(VecT a, VecT b, VecT c)         { return _mm256_fmadd_ps(a, b, c); }
+    static VecT Add(VecT a, VecT b)                 { return _mm256_add_ps(a, b); }
+    static VecT Mul(VecT a, VecT b)                 { return _mm256_mul_ps(a, b); }
+    static VecT Max(VecT a, VecT b)                 { return _mm256_max_ps(a, b); }
+    static VecT Min(VecT a, VecT b)                 { return _mm256_min_ps(a, b); }
+};
+
+#else
+
+template <typename ValueT>
+struct SimdTraits : ScalarTraits<ValueT> {};
+
+#endif
+
+
+/******************************************************************************
+ * Semirings
+ ******************************************************************************/
+
+/**
+ * (combine, multiply) pairs an output row is reduced over.  Identity() is the
+ * combine identity, the value of a row with no nonzeros; Accumulate(acc, a, x)
+ * is combine(acc, a * x) and Combine() merges two partial results (e.g. a
+ * thread's carry-out into the row it belongs to).  Each takes the SIMD (or
+ * scalar) traits to work in as a template parameter.
+ */
+template <typename ValueT>
+struct PlusTimes
+{
+    static ValueT Identity() { return ValueT(0); }
+
+    template <typename Simd>
+    static typename Simd::VecT Accumulate(typename Simd::VecT acc, typename Simd::VecT a, typename Simd::VecT x)
+    {
+        return Simd::Fma(a, x, acc);
+    }
+
+    template <typename Simd>
+    static typename Simd::VecT Combine(typename Simd::VecT a, typename Simd::VecT b)
+    {
+        return Simd::Add(a, b);
+    }
+};
+
+template <typename ValueT>
+struct MaxTimes
+{
+    static ValueT Identity() { return -std::numeric_limits<ValueT>::infinity(); }
+
+    template <typename Simd>
+    static typename Simd::VecT Accumulate(typename Simd::VecT acc, typename Simd::VecT a, typename Simd::VecT x)
+    {
+        return Simd::Max(acc, Simd::Mul(a, x));
+    }
+
+    template <typename Simd>
+    static typename Simd::VecT Combine(typename Simd::VecT a, typename Simd::VecT b)
+    {
+        return Simd::Max(a, b);
+    }
+};
+
+template <typename ValueT>
+struct MinTimes
+{
+    static ValueT Identity() { return std::numeric_limits<ValueT>::infinity(); }
+
+    template <typename Simd>
+    static typename Simd::VecT Accumulate(typename Simd::VecT acc, typename Simd::VecT a, typename Simd::VecT x)
+    {
+        return Simd::Min(acc, Simd::Mul(a, x));
+    }
+
+    template <typename Simd>
+    static typename Simd::VecT Combine(typename Simd::VecT a, typename Simd::VecT b)
+    {
+        return Simd::Min(a, b);
+    }
+};
+
+
+/******************************************************************************
+ * Row tiles
+ ******************************************************************************/
+
+/**
+ * Accumulator for TILE_K consecutive output columns of one row.  Tiles that
+ * are a multiple of the SIMD width live in vector registers; narrower tiles
+ * fall back to a fully unrolled scalar array.
+ */
+template <
+    int         TILE_K,
+    typename    ValueT,
+    typename    SemiringT   = PlusTimes<ValueT>,
+    bool        VECTORIZED  = (TILE_K % SimdTraits<ValueT>::WIDTH == 0)>
+struct SpmmTile
+{
+    typedef SimdTraits<ValueT>          Simd;
+    typedef typename Simd::VecT         VecT;
+    enum { VECS = TILE_K / Simd::WIDTH };
+
+    VecT acc[VECS];
+
+    void Zero()
+    {
+        VecT identity = Simd::Broadcast(SemiringT::Identity());
+        for (int v = 0; v < VECS; ++v)
+            acc[v] = identity;
+    }
+
+    // acc = combine(acc, a * x[0..TILE_K)), with x widened to ValueT
+    template <typename InputT>
+    void Fma(ValueT a, const InputT* x)
+    {
+        VecT a_vec = Simd::Broadcast(a);
+        for (int v = 0; v < VECS; ++v)
+            acc[v] = SemiringT::template Accumulate<Simd>(acc[v], a_vec, Simd::Load(x + v * Simd::WIDTH));
+    }
+
+    // acc[k] = combine(acc[k], a[k] * x[k]) for k in [0..TILE_K)
+    void FmaElementwise(const ValueT* a, const ValueT* x)
+    {
+        for (int v = 0; v < VECS; ++v)
+            acc[v] = SemiringT::template Accumulate<Simd>(acc[v], Simd::Load(a + v * Simd::WIDTH), Simd::Load(x + v * Simd::WIDTH));
+    }
+
+    // acc[k] = combine(acc[k], a[a_index[k]] * x[k]) for k in [0..TILE_K)
+    void FmaGather(const ValueT* a, const int* a_index, const ValueT* x)
+    {
+        for (int v = 0; v < VECS; ++v)
+            acc[v] = SemiringT::template Accumulate<Simd>(acc[v], Simd::Gather(a, a_index + v * Simd::WIDTH), Simd::Load(x + v * Simd::WIDTH));
+    }
+
+    // FmaGather for a_index constant across each vector: one broadcast per vector
+    void FmaBroadcastGather(const ValueT* a, const int* a_index, const ValueT* x)
+    {
+        for (int v = 0; v < VECS; ++v)
+            acc[v] = SemiringT::template Accumulate<Simd>(acc[v], Simd::Broadcast(a[a_index[v * Simd::WIDTH]]), Simd::Load(x + v * Simd::WIDTH));
+    }
+
+    // y[k * stride] = acc[k]
+    void Store(ValueT* y, int stride)
+    {
+        if (stride == 1)
+        {
+            for (int v = 0; v < VECS; ++v)
+                Simd::Store(y + v * Simd::WIDTH, acc[v]);
+        }
+        else
+        {
+            ValueT spill[TILE_K];
+            for (int v = 0; v < VECS; ++v)
+                Simd::Store(spill + v * Simd::WIDTH, acc[v]);
+            for (int k = 0; k < TILE_K; ++k)
+                y[k * stride] = spill[k];
+        }
+    }
+};
+
+template <
+    int         TILE_K,
+    typename    ValueT,
+    typename    SemiringT>
+struct SpmmTile<TILE_K, ValueT, SemiringT, false>
+{
+    typedef ScalarTraits<ValueT> Scalar;
+
+    ValueT acc[TILE_K];
+
+    void Zero()
+    {
+        for (int k = 0; k < TILE_K; ++k)
+            acc[k] = SemiringT::Identity();
+    }
+
+    template <typename InputT>
+    void Fma(ValueT a, const InputT* x)
+    {
+        for (int k = 0; k < TILE_K; ++k)
+            acc[k] = SemiringT::template Accumulate<Scalar>(acc[k], a, x[k]);
+    }
+
+    void FmaElementwise(const ValueT* a, const ValueT* x)
+    {
+        for (int k = 0; k < TILE_K; ++k)
+            acc[k] = SemiringT::template Accumulate<Scalar>(acc[k], a[k], x[k]);
+    }
+
+    void FmaGather(const ValueT* a, const int* a_index, const ValueT* x)
+    {
+        for (int k = 0; k < TILE_K; ++k)
+            acc[k] = SemiringT::template Accumulate<Scalar>(acc[k], a[a_index[k]], x[k]);
+    }
+
+    void FmaBroadcastGather(const ValueT* a, const int* a_index, const ValueT* x)
+    {
+        FmaGather(a, a_index, x);
+    }
+
+    void Store(ValueT* y, int stride)
+    {
+        for (int k = 0; k < TILE_K; ++k)
+            y[k * stride] = acc[k];
+    }
+};
+
+
+/**
+ * y[k * y_stride] = sum over nonzeros [nz_begin, nz_end) of
+ * values[nz] * x[column_indices[nz] * ldx + k], for k in [0, TILE_K), with
+ * the sum taken over SemiringT
+ */
+template <
+    int         TILE_K,
+    typename    SemiringT,
+    typename    ValueT,
+    typename    OffsetT,
+    typename    InputT>
+inline void SpmmRowTile(
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const InputT*   __restrict  x,
+    int                         ldx,
+    ValueT*         __restrict  y,
+    int                         y_stride)
+{
+    SpmmTile<TILE_K, ValueT, SemiringT> tile;
+    tile.Zero();
+    for (OffsetT nz = nz_begin; nz < nz_end; ++nz)
+        tile.Fma(values[nz], x + OffsetT(column_indices[nz]) * ldx);
+    tile.Store(y, y_stride);
+}
+
+
+/**
+ * Calls op.Tile<TILE_K>(k) over [0, num_vectors) in the tile sequence every
+ * row kernel uses: as many 64-wide tiles as fit, then at most one each of 32,
+ * 16, 8, 4, 2 and 1
+ */
+template <typename TileOpT>
+inline void SpmmTileSequence(
+    int                         num_vectors,
+    const TileOpT&              op)
+{
+    int k = 0;
+    for (; k + 64 <= num_vectors; k += 64)
+        op.template Tile<64>(k);
+
+    if (num_vectors - k >= 32) { op.template Tile<32>(k); k += 32; }
+    if (num_vectors - k >= 16) { op.template Tile<16>(k); k += 16; }
+    if (num_vectors - k >= 8)  { op.template Tile<8>(k); k += 8; }
+    if (num_vectors - k >= 4)  { op.template Tile<4>(k); k += 4; }
+    if (num_vectors - k >= 2)  { op.template Tile<2>(k); k += 2; }
+    if (num_vectors - k >= 1)  { op.template Tile<1>(k); k += 1; }
+}
+
+
+/**
+ * SpmmRowTile at column k, for SpmmTileSequence
+ */
+template <
+    typename    SemiringT,
+    typename    ValueT,
+    typename    OffsetT,
+    typename    InputT>
+struct SpmmRowTileOp
+{
+    const OffsetT*  column_indices;
+    const ValueT*   values;
+    OffsetT         nz_begin;
+    OffsetT         nz_end;
+    const InputT*   x;
+    int             ldx;
+    ValueT*         y;
+    int             y_stride;
+
+    SpmmRowTileOp(
+        const OffsetT*  column_indices,
+        const ValueT*   values,
+        OffsetT         nz_begin,
+        OffsetT         nz_end,
+        const InputT*   x,
+        int             ldx,
+        ValueT*         y,
+        int             y_stride)
+    :
+        column_indices(column_indices),
+        values(values),
+        nz_begin(nz_begin),
+        nz_end(nz_end),
+        x(x),
+        ldx(ldx),
+        y(y),
+        y_stride(y_stride)
+    {}
+
+    template <int TILE_K>
+    void Tile(int k) const
+    {
+        SpmmRowTile<TILE_K, SemiringT>(column_indices, values, nz_begin, nz_end, x + k, ldx, y + k * y_stride, y_stride);
+    }
+};
+
+
+/**
+ * SpmmRowTile over num_vectors columns, in SpmmTileSequence's tiles.  x is
+ * row-major with leading dimension ldx; consecutive output columns are
+ * y_stride apart.
+ */
+template <
+    typename    ValueT,
+    typename    OffsetT,
+    typename    SemiringT,
+    typename    InputT>
+inline void SpmmRow(
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const InputT*   __restrict  x,
+    int                         ldx,
+    int                         num_vectors,
+    ValueT*         __restrict  y,
+    int                         y_stride,
+    SemiringT                   /*semiring*/)
+{
+    SpmmTileSequence(num_vectors, SpmmRowTileOp<SemiringT, ValueT, OffsetT, InputT>(column_indices, values, nz_begin, nz_end, x, ldx, y, y_stride));
+}
+
+template <
+    typename    ValueT,
+    typename    OffsetT,
+    typename    InputT>
+inline void SpmmRow(
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const InputT*   __restrict  x,
+    int                         ldx,
+    int                         num_vectors,
+    ValueT*         __restrict  y,
+    int                         y_stride)
+{
+    SpmmRow(column_indices, values, nz_begin, nz_end, x, ldx, num_vectors, y, y_stride, PlusTimes<ValueT>());
+}
+
+
+/******************************************************************************
+ * Batched rows
+ ******************************************************************************/
+
+/**
+ * y[b] = sum over nonzeros [nz_begin, nz_end) of
+ * values[nz * batch_size + b] * x[column_indices[nz] * ldx + b], for b in
+ * [0, TILE_B): TILE_B single-vector problems at once, one lane each
+ */
+template <
+    int         TILE_B,
+    typename    ValueT,
+    typename    OffsetT>
+inline void SpmmBatchRowTile(
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    int                         batch_size,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const ValueT*   __restrict  x,
+    int                         ldx,
+    ValueT*         __restrict  y)
+{
+    SpmmTile<TILE_B, ValueT> tile;
+    tile.Zero();
+    for (OffsetT nz = nz_begin; nz < nz_end; ++nz)
+        tile.FmaElementwise(values + size_t(nz) * batch_size, x + size_t(column_indices[nz]) * ldx);
+    tile.Store(y, 1);
+}
+
+
+/**
+ * SpmmBatchRowTile at batch entry b, for SpmmTileSequence
+ */
+template <
+    typename    ValueT,
+    typename    OffsetT>
+struct SpmmBatchRowTileOp
+{
+    const OffsetT*  column_indices;
+    const ValueT*   values;
+    int             batch_size;
+    OffsetT         nz_begin;
+    OffsetT         nz_end;
+    const ValueT*   x;
+    int             ldx;
+    ValueT*         y;
+
+    SpmmBatchRowTileOp(
+        const OffsetT*  column_indices,
+        const ValueT*   values,
+        int             batch_size,
+        OffsetT         nz_begin,
+        OffsetT         nz_end,
+        const ValueT*   x,
+        int             ldx,
+        ValueT*         y)
+    :
+        column_indices(column_indices),
+        values(values),
+        batch_size(batch_size),
+        nz_begin(nz_begin),
+        nz_end(nz_end),
+        x(x),
+        ldx(ldx),
+        y(y)
+    {}
+
+    template <int TILE_B>
+    void Tile(int b) const
+    {
+        SpmmBatchRowTile<TILE_B>(column_indices, values + b, batch_size, nz_begin, nz_end, x + b, ldx, y + b);
+    }
+};
+
+
+/**
+ * TILE_J consecutive outputs of one batched row, starting at output j of the
+ * row's batch_size * num_vectors (batch entry (j + t) / num_vectors, vector
+ * (j + t) % num_vectors for lane t).  Each nonzero's column index is read
+ * once for the whole tile and gathers one contiguous run of the X row; each
+ * lane's value is gathered from the nonzero's batch_size interleaved values.
+ * For SpmmTileSequence.
+ */
+template <
+    typename    ValueT,
+    typename    OffsetT>
+struct SpmmBatchGatherTileOp
+{
+    const OffsetT*  column_indices;
+    const ValueT*   values;
+    int             batch_size;
+    OffsetT         nz_begin;
+    OffsetT         nz_end;
+    const ValueT*   x;
+    int             ldx;
+    int             num_vectors;
+    ValueT*         y;
+
+    SpmmBatchGatherTileOp(
+        const OffsetT*  column_indices,
+        const ValueT*   values,
+        int             batch_size,
+        OffsetT         nz_begin,
+        OffsetT         nz_end,
+        const ValueT*   x,
+        int             ldx,
+        int             num_vectors,
+        ValueT*         y)
+    :
+        column_indices(column_indices),
+        values(values),
+        batch_size(batch_size),
+        nz_begin(nz_begin),
+        nz_end(nz_end),
+        x(x),
+        ldx(ldx),
+        num_vectors(num_vectors),
+        y(y)
+    {}
+
+    template <int TILE_J>
+    void Tile(int j) const
+    {
+        SpmmTile<TILE_J, ValueT> tile;
+        tile.Zero();
+
+        int first_problem   = j / num_vectors;
+        int last_problem    = (j + TILE_J - 1) / num_vectors;
+        if (first_problem == last_problem)
+        {
+            // The whole tile lies within one problem
+            const ValueT* values_b = values + first_problem;
+            for (OffsetT nz = nz_begin; nz < nz_end; ++nz)
+                tile.Fma(values_b[size_t(nz) * batch_size], x + size_t(column_indices[nz]) * ldx + j);
+        }
+        else
+        {
+            // Problem of each lane
+            int value_index[TILE_J];
+            int k = j - first_problem * num_vectors;
+            for (int t = 0, b = first_problem; t < TILE_J; ++t)
+            {
+                value_index[t] = b;
+                if (++k == num_vectors) { k = 0; ++b; }
+            }
+
+            if (num_vectors % SimdTraits<ValueT>::WIDTH == 0)
+            {
+                // Every SIMD vector of the tile lies within one problem
+                for (OffsetT nz = nz_begin; nz < nz_end; ++nz)
+                    tile.FmaBroadcastGather(values + size_t(nz) * batch_size, value_index, x + size_t(column_indices[nz]) * ldx + j);
+            }
+            else
+            {
+                for (OffsetT nz = nz_begin; nz < nz_end; ++nz)
+                    tile.FmaGather(values + size_t(nz) * batch_size, value_index, x + size_t(column_indices[nz]) * ldx + j);
+            }
+        }
+        tile.Store(y + j, 1);
+    }
+};
+
+
+/**
+ * One row of batch_size problems sharing a sparsity pattern: values are
+ * interleaved by problem (values[nz * batch_size + b]) and rows of x and y
+ * hold every problem's num_vectors values back to back (x[c * ldx +
+ * b * num_vectors + k], y[b * num_vectors + k]).  The row's
+ * batch_size * num_vectors outputs are covered in SpmmTileSequence's tiles,
+ * so a tile spans several problems whenever num_vectors is narrower than
+ * it, and each column index is read once per tile rather than once per
+ * problem.  Single-vector batches load their lane values contiguously.
+ */
+template <
+    typename    ValueT,
+    typename    OffsetT>
+inline void SpmmBatchRow(
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    int                         batch_size,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const ValueT*   __restrict  x,
+    int                         ldx,
+    int                         num_vectors,
+    ValueT*         __restrict  y)
+{
+    if (num_vectors == 1)
+        SpmmTileSequence(batch_size, SpmmBatchRowTileOp<ValueT, OffsetT>(column_indices, values, batch_size, nz_begin, nz_end, x, ldx, y));
+    else
+        SpmmTileSequence(batch_size * num_vectors, SpmmBatchGatherTileOp<ValueT, OffsetT>(column_indices, values, batch_size, nz_begin, nz_end, x, ldx, num_vectors, y));
+}
+
+
+/******************************************************************************
+ * Transposed (scatter) rows
+ ******************************************************************************/
+
+/**
+ * y[(column_indices[nz] - row_base) * ldy + k] += values[nz] * x[k] for each
+ * nonzero in [nz_begin, nz_end) and k in [0, TILE_K): one row of X scattered
+ * into the Y rows named by a row of A^T.  y is row-major.
+ */
+template <
+    int         TILE_K,
+    typename    ValueT,
+    typename    OffsetT>
+inline void SpmmScatterRowTile(
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const ValueT*   __restrict  x,
+    ValueT*         __restrict  y,
+    int                         ldy,
+    OffsetT                     row_base)
+{
+    ValueT x_tile[TILE_K];
+    for (int k = 0; k < TILE_K; ++k)
+        x_tile[k] = x[k];
+
+    for (OffsetT nz = nz_begin; nz < nz_end; ++nz)
+    {
+        ValueT  a       = values[nz];
+        ValueT* y_row   = y + size_t(column_indices[nz] - row_base) * ldy;
+        for (int k = 0; k < TILE_K; ++k)
+            y_row[k] += a * x_tile[k];
+    }
+}
+
+
+/**
+ * SpmmScatterRowTile at column k, for SpmmTileSequence
+ */
+template <
+    typename    ValueT,
+    typename    OffsetT>
+struct SpmmScatterRowTileOp
+{
+    const OffsetT*  column_indices;
+    const ValueT*   values;
+    OffsetT         nz_begin;
+    OffsetT         nz_end;
+    const ValueT*   x;
+    ValueT*         y;
+    int             ldy;
+    OffsetT         row_base;
+
+    SpmmScatterRowTileOp(
+        const OffsetT*  column_indices,
+        const ValueT*   values,
+        OffsetT         nz_begin,
+        OffsetT         nz_end,
+        const ValueT*   x,
+        ValueT*         y,
+        int             ldy,
+        OffsetT         row_base)
+    :
+        column_indices(column_indices),
+        values(values),
+        nz_begin(nz_begin),
+        nz_end(nz_end),
+        x(x),
+        y(y),
+        ldy(ldy),
+        row_base(row_base)
+    {}
+
+    template <int TILE_K>
+    void Tile(int k) const
+    {
+        SpmmScatterRowTile<TILE_K>(column_indices, values, nz_begin, nz_end, x + k, y + k, ldy, row_base);
+    }
+};
+
+
+/**
+ * SpmmScatterRowTile over num_vectors columns, in SpmmTileSequence's tiles
+ */
+template <
+    typename    ValueT,
+    typename    OffsetT>
+inline void SpmmScatterRow(
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const ValueT*   __restrict  x,
+    int                         num_vectors,
+    ValueT*         __restrict  y,
+    int                         ldy,
+    OffsetT                     row_base)
+{
+    SpmmTileSequence(num_vectors, SpmmScatterRowTileOp<ValueT, OffsetT>(column_indices, values, nz_begin, nz_end, x, y, ldy, row_base));
+}
+
+
+/******************************************************************************
+ * Row epilogues
+ ******************************************************************************/
+
+/**
+ * Row scale factors: none, or one per row (1/deg, D^-1/2, ...)
+ */
+template <typename ValueT>
+struct NoRowScale
+{
+    template <typename OffsetT>
+    ValueT operator()(OffsetT /*row*/) const { return ValueT(1); }
+};
+
+template <typename ValueT>
+struct RowScale
+{
+    const ValueT* scale;
+
+    RowScale(const ValueT* scale = NULL) : scale(scale) {}
+
+    template <typename OffsetT>
+    ValueT operator()(OffsetT row) const { return scale[row]; }
+};
+
+
+/**
+ * Column bias: none, or a num_vectors-long vector added to every row
+ */
+template <typename ValueT>
+struct NoBias
+{
+    ValueT operator()(int /*k*/) const { return ValueT(0); }
+};
+
+template <typename ValueT>
+struct ColumnBias
+{
+    const ValueT* bias;
+
+    ColumnBias(const ValueT* bias = NULL) : bias(bias) {}
+
+    ValueT operator()(int k) const { return bias[k]; }
+};
+
+
+/**
+ * Activations
+ */
+template <typename ValueT>
+struct IdentityActivation
+{
+    ValueT operator()(ValueT v) const { return v; }
+};
+
+template <typename ValueT>
+struct ReluActivation
+{
+    ValueT operator()(ValueT v) const { return (v > ValueT(0)) ? v : ValueT(0); }
+};
+
+
+/**
+ * y[k * y_stride] = activation(scale(row) * y[k * y_stride] + bias(k)) for k
+ * in [0, num_vectors).  Kernels apply it exactly once to each output row,
+ * after the row's carry-outs (if any) have been added.
+ */
+template <
+    typename ScaleT,
+    typename BiasT,
+    typename ActivationT>
+struct SpmmEpilogue
+{
+    ScaleT      scale;
+    BiasT       bias;
+    ActivationT activation;
+
+    SpmmEpilogue(
+        ScaleT      scale       = ScaleT(),
+        BiasT       bias        = BiasT(),
+        ActivationT activation  = ActivationT())
+    :
+        scale(scale),
+        bias(bias),
+        activation(activation)
+    {}
+
+    template <typename ValueT, typename OffsetT>
+    void operator()(OffsetT row, ValueT* y, int y_stride, int num_vectors) const
+    {
+        ValueT s = scale(row);
+        for (int k = 0; k < num_vectors; ++k)
+            y[k * y_stride] = activation(s * y[k * y_stride] + bias(k));
+    }
+};
+
+
+/**
+ * Plain SpMM: leaves output rows as computed
+ */
+struct NoEpilogue
+{
+    template <typename ValueT, typename OffsetT>
+    void operator()(OffsetT /*row*/, ValueT* /*y*/, int /*y_stride*/, int /*num_vectors*/) const {}
+};
+
+
+/******************************************************************************
+ * Streaming stores
+ ******************************************************************************/
+
+/**
+ * Non-temporal store of one 64-byte cache line to a line-aligned dst: the
+ * line goes to memory through the write-combining buffers without first
+ * being read for ownership
+ */
+inline void StreamLine(void* dst, const void* src)
+{
+#if defined(__AVX512F__)
+    _mm512_stream_si512((__m512i*) dst, _mm512_loadu_si512(src));
+#elif defined(__AVX__)
+    _mm256_stream_si256((__m256i*) dst,     _mm256_loadu_si256((const __m256i*) src));
+    _mm256_stream_si256((__m256i*) dst + 1, _mm256_loadu_si256((const __m256i*) src + 1));
+#else
+    for (int i = 0; i < 4; ++i)
+        _mm_stream_si128((__m128i*) dst + i, _mm_loadu_si128((const __m128i*) src + i));
+#endif
+}
+
+
+/**
+ * Write-combining buffer for one output stream.  Values written to
+ * consecutive addresses are gathered into their cache line, and a line the
+ * stream covers completely is written with StreamLine().  A line it only
+ * partly covers (the ends of the stream, or where it jumps) is written with
+ * ordinary stores, so lines shared with other writers are never streamed.
+ * Call Flush() once the stream is done, then fence before the output is
+ * read by another thread.
+ */
+template <typename ValueT>
+struct StreamingLineBuffer
+{
+    enum
+    {
+        LINE_BYTES  = 64,
+        LINE_ITEMS  = LINE_BYTES / sizeof(ValueT),
+    };
+
+    ValueT      line[LINE_ITEMS];
+    ValueT*     line_base;          // Line-aligned destination of line[], or NULL when empty
+    int         lo;                 // Buffered items are line[lo, hi)
+    int         hi;
+    size_t      streamed_lines;
+
+    StreamingLineBuffer() : line_base(NULL), lo(0), hi(0), streamed_lines(0) {}
+
+    void Flush()
+    {
+        if (line_base)
+        {
+            for (int i = lo; i < hi; ++i)
+                line_base[i] = line[i];
+        }
+        line_base = NULL;
+    }
+
+    void Put(ValueT* p, ValueT v)
+    {
+        ValueT* base    = (ValueT*) (size_t(p) & ~size_t(LINE_BYTES - 1));
+        int     i       = int(p - base);
+        if ((base != line_base) || (i != hi))
+        {
+            Flush();
+            line_base   = base;
+            lo          = i;
+            hi          = i;
+        }
+
+        line[hi++] = v;
+        if (hi == LINE_ITEMS)
+        {
+            if (lo == 0)
+            {
+                StreamLine(line_base, line);
+                streamed_lines++;
+                line_base = NULL;
+            }
+            else
+            {
+                Flush();
+            }
+        }
+    }
+
+    // Write n values to consecutive addresses from p, streaming whole lines straight from src
+    void Put(ValueT* p, const ValueT* src, int n)
+    {
+        while (n > 0)
+        {
+            if ((line_base == NULL) && (n >= LINE_ITEMS) && ((size_t(p) & (LINE_BYTES - 1)) == 0))
+            {
+                StreamLine(p, src);
+                streamed_lines++;
+                p   += LINE_ITEMS;
+                src += LINE_ITEMS;
+                n   -= LINE_ITEMS;
+            }
+            else
+            {
+                Put(p++, *src++);
+                n--;
+            }
+        }
+    }
+};
+
+
+/******************************************************************************
+ * Scratch
+ ******************************************************************************/
+
+/**
+ * Per-thread scratch for merge-path SpMM: each thread's K-wide carry-out
+ * vector and carry-out row, in its own cache-line-aligned block so threads
+ * never share a line.  Allocated once and reused across calls; Reserve()
+ * only reallocates when asked for more threads or vectors than it holds.
+ */
+template <
+    typename    ValueT,
+    typename    OffsetT>
+struct SpmmScratch
+{
+    enum { CACHE_LINE_BYTES = 64 };
+
+    int         num_threads;
+    int         num_vectors;
+    size_t      carry_bytes;        // Bytes of carry-out values per thread (padded to a cache line)
+    size_t      thread_bytes;       // Bytes per thread block
+    char*       storage;
+
+    SpmmScratch() : num_threads(0), num_vectors(0), carry_bytes(0), thread_bytes(0), storage(NULL) {}
+
+    SpmmScratch(int num_threads, int num_vectors) : num_threads(0), num_vectors(0), carry_bytes(0), thread_bytes(0), storage(NULL)
+    {
+        Reserve(num_threads, num_vectors);
+    }
+
+    ~SpmmScratch()
+    {
+        if (storage) _mm_free(storage);
+    }
+
+    void Reserve(int num_threads, int num_vectors)
+    {
+        if ((num_threads <= this->num_threads) && (num_vectors <= this->num_vectors))
+            return;
+
+        if (storage) _mm_free(storage);
+
+        this->num_threads   = std::max(num_threads, this->num_threads);
+        this->num_vectors   = std::max(num_vectors, this->num_vectors);
+        carry_bytes         = (sizeof(ValueT) * this->num_vectors + CACHE_LINE_BYTES - 1) / CACHE_LINE_BYTES * CACHE_LINE_BYTES;
+        thread_bytes        = carry_bytes + CACHE_LINE_BYTES;
+        storage             = (char*) _mm_malloc(thread_bytes * this->num_threads, CACHE_LINE_BYTES);
+    }
+
+    // The running totals of thread tid's partial last row
+    ValueT* Carry(int tid)
+    {
+        return (ValueT*) (storage + thread_bytes * tid);
+    }
+
+    // The row thread tid's carry-out belongs to
+    OffsetT& CarryRow(int tid)
+    {
+        return *(OffsetT*) (storage + thread_bytes * tid + carry_bytes);
+    }
+};
+
+
+/******************************************************************************
+ * Column-major X
+ ******************************************************************************/
+
+/**
+ * y[s * y_stride] = sum over nonzeros [nz_begin, nz_end) of
+ * values[nz] * x[s * ldx + column_indices[nz]], for s in [0, STRIP), where x
+ * is column-major with leading dimension ldx
+ */
+template <
+    int         STRIP,
+    typename    SemiringT,
+    typename    ValueT,
+    typename    OffsetT,
+    typename    InputT>
+inline void SpmmRowStrip(
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const InputT*   __restrict  x,
+    int                         ldx,
+    ValueT*         __restrict  y,
+    int                         y_stride)
+{
+    typedef ScalarTraits<ValueT> Scalar;
+
+    ValueT acc[STRIP];
+    for (int s = 0; s < STRIP; ++s)
+        acc[s] = SemiringT::Identity();
+
+    for (OffsetT nz = nz_begin; nz < nz_end; ++nz)
+    {
+        ValueT          a       = values[nz];
+        const InputT*   x_col   = x + column_indices[nz];
+        for (int s = 0; s < STRIP; ++s)
+            acc[s] = SemiringT::template Accumulate<Scalar>(acc[s], a, x_col[size_t(s) * ldx]);
+    }
+
+    for (int s = 0; s < STRIP; ++s)
+        y[s * y_stride] = acc[s];
+}
+
+
+/**
+ * SpmmRowStrip over num_vectors columns of a column-major X: strips of 8,
+ * then at most one each of 4, 2 and 1
+ */
+template <
+    typename    ValueT,
+    typename    OffsetT,
+    typename    SemiringT,
+    typename    InputT>
+inline void SpmmRowColMajor(
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const InputT*   __restrict  x,
+    int                         ldx,
+    int                         num_vectors,
+    ValueT*         __restrict  y,
+    int                         y_stride,
+    SemiringT                   /*semiring*/)
+{
+    int k = 0;
+    for (; k + 8 <= num_vectors; k += 8)
+        SpmmRowStrip<8, SemiringT>(column_indices, values, nz_begin, nz_end, x + size_t(k) * ldx, ldx, y + k * y_stride, y_stride);
+
+    if (num_vectors - k >= 4) { SpmmRowStrip<4, SemiringT>(column_indices, values, nz_begin, nz_end, x + size_t(k) * ldx, ldx, y + k * y_stride, y_stride); k += 4; }
+    if (num_vectors - k >= 2) { SpmmRowStrip<2, SemiringT>(column_indices, values, nz_begin, nz_end, x + size_t(k) * ldx, ldx, y + k * y_stride, y_stride); k += 2; }
+    if (num_vectors - k >= 1) { SpmmRowStrip<1, SemiringT>(column_indices, values, nz_begin, nz_end, x + size_t(k) * ldx, ldx, y + k * y_stride, y_stride); k += 1; }
+}
+
+
+/**
+ * SpmmRow or SpmmRowColMajor, by the layout of x
+ */
+template <
+    typename    ValueT,
+    typename    OffsetT,
+    typename    SemiringT,
+    typename    InputT>
+inline void SpmmRow(
+    bool                        x_row_major,
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const InputT*   __restrict  x,
+    int                         ldx,
+    int                         num_vectors,
+    ValueT*         __restrict  y,
+    int                         y_stride,
+    SemiringT                   semiring)
+{
+    if (x_row_major)
+        SpmmRow(column_indices, values, nz_begin, nz_end, x, ldx, num_vectors, y, y_stride, semiring);
+    else
+        SpmmRowColMajor(column_indices, values, nz_begin, nz_end, x, ldx, num_vectors, y, y_stride, semiring);
+}
+
+template <
+    typename    ValueT,
+    typename    OffsetT,
+    typename    InputT>
+inline void SpmmRow(
+    bool                        x_row_major,
+    const OffsetT*  __restrict  column_indices,
+    const ValueT*   __restrict  values,
+    OffsetT                     nz_begin,
+    OffsetT                     nz_end,
+    const InputT*   __restrict  x,
+    int                         ldx,
+    int                         num_vectors,
+    ValueT*         __restrict  y,
+    int                         y_stride)
+{
+    SpmmRow(x_row_major, column_indices, values, nz_begin, nz_end, x, ldx, num_vectors, y, y_stride, PlusTimes<ValueT>());
+}
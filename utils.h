@@ -53,6 +53,10 @@
     #include "omp.h"
 #endif
 
+#if defined(__AVX512F__)
+    #include <immintrin.h>
+#endif
+
 
 /******************************************************************************
  * Assertion macros
@@ -754,6 +758,195 @@ void transpose(ValueT* dst, const ValueT* src, size_t n, size_t p) {
 }
 
 
+/******************************************************************************
+ * Parallel cache-blocked transpose
+ ******************************************************************************/
+
+/**
+ * Transpose of one DIM x DIM microtile: src rows are lds apart, dst rows ldd
+ * apart.  The generic version is scalar; AVX-512 builds specialize double
+ * (8x8) and float (16x16) to transpose in registers, optionally writing the
+ * result with non-temporal stores (dst rows must then be 64-byte aligned).
+ */
+template <typename ValueT>
+struct TransposeMicroTile
+{
+    enum { DIM = 8 };
+
+    static void Run(ValueT* dst, size_t ldd, const ValueT* src, size_t lds, bool /*stream*/)
+    {
+        for (int j = 0; j < DIM; ++j)
+            for (int i = 0; i < DIM; ++i)
+                dst[j * ldd + i] = src[i * lds + j];
+    }
+};
+
+#if defined(__AVX512F__)
+
+template <>
+struct TransposeMicroTile<double>
+{
+    enum { DIM = 8 };
+
+    static void Run(double* dst, size_t ldd, const double* src, size_t lds, bool stream)
+    {
+        __m512d r[8], t[8];
+        for (int i = 0; i < 8; ++i)
+            r[i] = _mm512_loadu_pd(src + i * lds);
+
+        // Interleave row pairs within each 128-bit lane
+        for (int i = 0; i < 8; i += 2)
+        {
+            t[i]        = _mm512_unpacklo_pd(r[i], r[i + 1]);
+            t[i + 1]    = _mm512_unpackhi_pd(r[i], r[i + 1]);
+        }
+
+        // Gather lanes of row quads: r[0..3] hold columns {0,4}, {2,6}, {1,5}, {3,7} of rows 0-3
+        r[0] = _mm512_shuffle_f64x2(t[0], t[2], 0x88);
+        r[1] = _mm512_shuffle_f64x2(t[0], t[2], 0xDD);
+        r[2] = _mm512_shuffle_f64x2(t[1], t[3], 0x88);
+        r[3] = _mm512_shuffle_f64x2(t[1], t[3], 0xDD);
+        r[4] = _mm512_shuffle_f64x2(t[4], t[6], 0x88);
+        r[5] = _mm512_shuffle_f64x2(t[4], t[6], 0xDD);
+        r[6] = _mm512_shuffle_f64x2(t[5], t[7], 0x88);
+        r[7] = _mm512_shuffle_f64x2(t[5], t[7], 0xDD);
+
+        // Join the two row quads of each column
+        t[0] = _mm512_shuffle_f64x2(r[0], r[4], 0x88);
+        t[4] = _mm512_shuffle_f64x2(r[0], r[4], 0xDD);
+        t[2] = _mm512_shuffle_f64x2(r[1], r[5], 0x88);
+        t[6] = _mm512_shuffle_f64x2(r[1], r[5], 0xDD);
+        t[1] = _mm512_shuffle_f64x2(r[2], r[6], 0x88);
+        t[5] = _mm512_shuffle_f64x2(r[2], r[6], 0xDD);
+        t[3] = _mm512_shuffle_f64x2(r[3], r[7], 0x88);
+        t[7] = _mm512_shuffle_f64x2(r[3], r[7], 0xDD);
+
+        if (stream)
+            for (int j = 0; j < 8; ++j) _mm512_stream_pd(dst + j * ldd, t[j]);
+        else
+            for (int j = 0; j < 8; ++j) _mm512_storeu_pd(dst + j * ldd, t[j]);
+    }
+};
+
+
+template <>
+struct TransposeMicroTile<float>
+{
+    enum { DIM = 16 };
+
+    static void Run(float* dst, size_t ldd, const float* src, size_t lds, bool stream)
+    {
+        __m512 r[16], t[16];
+        for (int i = 0; i < 16; ++i)
+            r[i] = _mm512_loadu_ps(src + i * lds);
+
+        // Interleave row pairs within each 128-bit lane
+        for (int i = 0; i < 16; i += 2)
+        {
+            t[i]        = _mm512_unpacklo_ps(r[i], r[i + 1]);
+            t[i + 1]    = _mm512_unpackhi_ps(r[i], r[i + 1]);
+        }
+
+        // Interleave pair-of-row pairs: lane L of r[4q + c] holds rows 4q..4q+3 of column 4L + c
+        for (int q = 0; q < 4; ++q)
+        {
+            __m512d lo0 = _mm512_castps_pd(t[4 * q]);
+            __m512d hi0 = _mm512_castps_pd(t[4 * q + 1]);
+            __m512d lo1 = _mm512_castps_pd(t[4 * q + 2]);
+            __m512d hi1 = _mm512_castps_pd(t[4 * q + 3]);
+            r[4 * q]        = _mm512_castpd_ps(_mm512_unpacklo_pd(lo0, lo1));
+            r[4 * q + 1]    = _mm512_castpd_ps(_mm512_unpackhi_pd(lo0, lo1));
+            r[4 * q + 2]    = _mm512_castpd_ps(_mm512_unpacklo_pd(hi0, hi1));
+            r[4 * q + 3]    = _mm512_castpd_ps(_mm512_unpackhi_pd(hi0, hi1));
+        }
+
+        // Gather the four row quads of each column
+        for (int c = 0; c < 4; ++c)
+        {
+            __m512 e0 = _mm512_shuffle_f32x4(r[c], r[4 + c], 0x44);
+            __m512 e1 = _mm512_shuffle_f32x4(r[c], r[4 + c], 0xEE);
+            __m512 f0 = _mm512_shuffle_f32x4(r[8 + c], r[12 + c], 0x44);
+            __m512 f1 = _mm512_shuffle_f32x4(r[8 + c], r[12 + c], 0xEE);
+            t[c]        = _mm512_shuffle_f32x4(e0, f0, 0x88);
+            t[4 + c]    = _mm512_shuffle_f32x4(e0, f0, 0xDD);
+            t[8 + c]    = _mm512_shuffle_f32x4(e1, f1, 0x88);
+            t[12 + c]   = _mm512_shuffle_f32x4(e1, f1, 0xDD);
+        }
+
+        if (stream)
+            for (int j = 0; j < 16; ++j) _mm512_stream_ps(dst + j * ldd, t[j]);
+        else
+            for (int j = 0; j < 16; ++j) _mm512_storeu_ps(dst + j * ldd, t[j]);
+    }
+};
+
+#endif // __AVX512F__
+
+
+/**
+ * Parallel transpose with the same contract as transpose(): src is n x p
+ * row-major, dst becomes p x n row-major.  Square cache tiles of four
+ * microtiles a side are dealt statically to threads; full microtiles go
+ * through TransposeMicroTile and ragged edges are copied element-wise.  When
+ * the output exceeds stream_bytes and every microtile row of dst is 64-byte
+ * aligned, stores bypass the cache since the result will not be re-read
+ * before it is evicted anyway.
+ */
+template <typename ValueT>
+void ParallelTranspose(
+    ValueT*         dst,
+    const ValueT*   src,
+    size_t          n,
+    size_t          p,
+    int             num_threads,
+    size_t          stream_bytes = size_t(16) << 20)
+{
+    const size_t DIM    = TransposeMicroTile<ValueT>::DIM;
+    const size_t TILE   = DIM * 4;
+
+    bool stream =
+        (n * p * sizeof(ValueT) > stream_bytes) &&
+        ((n * sizeof(ValueT)) % 64 == 0) &&
+        ((size_t(dst) % 64) == 0);
+
+    long long tiles_n   = (n + TILE - 1) / TILE;
+    long long tiles_p   = (p + TILE - 1) / TILE;
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        #pragma omp for schedule(static)
+        for (long long tile = 0; tile < tiles_n * tiles_p; ++tile)
+        {
+            size_t i_begin  = size_t(tile / tiles_p) * TILE;
+            size_t j_begin  = size_t(tile % tiles_p) * TILE;
+            size_t i_end    = std::min(i_begin + TILE, n);
+            size_t j_end    = std::min(j_begin + TILE, p);
+
+            for (size_t i = i_begin; i < i_end; i += DIM)
+            {
+                for (size_t j = j_begin; j < j_end; j += DIM)
+                {
+                    if ((i + DIM <= n) && (j + DIM <= p))
+                    {
+                        TransposeMicroTile<ValueT>::Run(dst + j * n + i, n, src + i * p + j, p, stream);
+                    }
+                    else
+                    {
+                        for (size_t jj = j; jj < std::min(j + DIM, p); ++jj)
+                            for (size_t ii = i; ii < std::min(i + DIM, n); ++ii)
+                                dst[jj * n + ii] = src[ii * p + jj];
+                    }
+                }
+            }
+        }
+
+#if defined(__AVX512F__)
+        if (stream) _mm_sfence();
+#endif
+    }
+}
+
+
 #ifdef __NVCC__
 
 /**